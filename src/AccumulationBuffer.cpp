@@ -0,0 +1,177 @@
+#include "AccumulationBuffer.h"
+
+AccumulationBuffer::AccumulationBuffer(const uvec2& size, u32 channels) : m_size(size), m_channels(channels) {
+    size_t pixelCount = (size_t)size.x * size.y;
+    m_sampleCount.resize(pixelCount, 0);
+
+    auto allocate = [&](auto& planes, OutputChannel channel, auto value) {
+        if (!(m_channels & (u32)channel))
+            return;
+
+        for (auto& plane : planes)
+            plane.resize(pixelCount, value);
+    };
+
+    allocate(m_color, OutputChannel::Color, 0.0f);
+    allocate(m_depth, OutputChannel::Depth, 0.0f);
+    allocate(m_normal, OutputChannel::Normal, 0.0f);
+    allocate(m_normalSampleCount, OutputChannel::Normal, 0U);
+    allocate(m_albedo, OutputChannel::Albedo, 0.0f);
+    allocate(m_albedoSampleCount, OutputChannel::Albedo, 0U);
+    allocate(m_emission, OutputChannel::Emission, 0.0f);
+    allocate(m_luminanceMoments, OutputChannel::Variance, 0.0);
+#ifdef BVH_TEST
+    allocate(m_aabbTestCount, OutputChannel::AABBTestCount, 0.0f);
+    allocate(m_triangleTestCount, OutputChannel::TriangleTestCount, 0.0f);
+#endif
+}
+
+void AccumulationBuffer::merge(const AccumulationBuffer& other) {
+    if (other.m_size != m_size || other.m_channels != m_channels)
+        throw std::runtime_error("Merged accumulation buffers differ in size or channels");
+
+    auto mergeSums = [&](auto& planes, const auto& otherPlanes, OutputChannel channel) {
+        if (!(m_channels & (u32)channel))
+            return;
+
+        for (size_t i = 0; i < planes.size(); i++) {
+            NODEBUG_ONLY(_Pragma("omp parallel for"))
+            for (i32 j = 0; j < (i32)m_sampleCount.size(); j++)
+                planes[i][j] += otherPlanes[i][j];
+        }
+    };
+
+    mergeSums(m_color, other.m_color, OutputChannel::Color);
+    mergeSums(m_depth, other.m_depth, OutputChannel::Depth);
+    mergeSums(m_normal, other.m_normal, OutputChannel::Normal);
+    mergeSums(m_normalSampleCount, other.m_normalSampleCount, OutputChannel::Normal);
+    mergeSums(m_albedo, other.m_albedo, OutputChannel::Albedo);
+    mergeSums(m_albedoSampleCount, other.m_albedoSampleCount, OutputChannel::Albedo);
+    mergeSums(m_emission, other.m_emission, OutputChannel::Emission);
+    mergeSums(m_luminanceMoments, other.m_luminanceMoments, OutputChannel::Variance);
+#ifdef BVH_TEST
+    mergeSums(m_aabbTestCount, other.m_aabbTestCount, OutputChannel::AABBTestCount);
+    mergeSums(m_triangleTestCount, other.m_triangleTestCount, OutputChannel::TriangleTestCount);
+#endif
+
+    for (size_t i = 0; i < m_sampleCount.size(); i++)
+        m_sampleCount[i] += other.m_sampleCount[i];
+}
+
+RenderOutput AccumulationBuffer::resolve(u32 channels, bool fillUnsampled) const {
+    channels &= m_channels;
+
+    RenderOutput output;
+    if (channels & (u32)OutputChannel::Color)
+        output.color = resolveSums<vec3>(m_color, fillUnsampled);
+    if (channels & (u32)OutputChannel::Depth)
+        output.depth = resolveSums<f32>(m_depth, fillUnsampled);
+    if (channels & (u32)OutputChannel::Normal)
+        output.normal = resolveMeans(m_normal, m_normalSampleCount[0], fillUnsampled);
+    if (channels & (u32)OutputChannel::Albedo)
+        output.albedo = resolveMeans(m_albedo, m_albedoSampleCount[0], fillUnsampled);
+    if (channels & (u32)OutputChannel::Emission)
+        output.emission = resolveSums<vec3>(m_emission, fillUnsampled);
+    if (channels & (u32)OutputChannel::Variance && m_channels & (u32)OutputChannel::Color) {
+        output.variance = Texture<f32>(m_size);
+        f32* variance = output.variance.data();
+
+        NODEBUG_ONLY(_Pragma("omp parallel for"))
+        for (i32 i = 0; i < (i32)m_sampleCount.size(); i++)
+            variance[i] = (f32)varianceOfMean(fillUnsampled ? sampledPixel(i) : i);
+    }
+#ifdef BVH_TEST
+    if (channels & (u32)OutputChannel::AABBTestCount)
+        output.aabbTestCount = resolveSums<f32>(m_aabbTestCount, fillUnsampled);
+    if (channels & (u32)OutputChannel::TriangleTestCount)
+        output.triangleTestCount = resolveSums<f32>(m_triangleTestCount, fillUnsampled);
+#endif
+
+    return output;
+}
+
+f32 AccumulationBuffer::estimateError() const {
+    u32 required = (u32)OutputChannel::Color | (u32)OutputChannel::Variance;
+    if ((m_channels & required) != required || m_sampleCount.empty())
+        return NAN;
+
+    // Only sampled pixels, regions of interest leave the rest empty
+    f64 varianceSum = 0;
+    u64 sampledPixelCount = 0;
+    NODEBUG_ONLY(_Pragma("omp parallel for reduction(+ : varianceSum, sampledPixelCount)"))
+    for (i32 i = 0; i < (i32)m_sampleCount.size(); i++) {
+        if (m_sampleCount[i] == 0)
+            continue;
+
+        varianceSum += varianceOfMean(i);
+        sampledPixelCount++;
+    }
+
+    if (sampledPixelCount == 0)
+        return NAN;
+
+    return (f32)std::sqrt(varianceSum / sampledPixelCount);
+}
+
+u32 AccumulationBuffer::maxSampleCount() const {
+    return m_sampleCount.empty() ? 0 : *std::max_element(m_sampleCount.begin(), m_sampleCount.end());
+}
+
+u32 AccumulationBuffer::sampledPixel(u32 pixelIndex) const {
+    if (m_sampleCount[pixelIndex] != 0)
+        return pixelIndex;
+
+    // Progressive levels sample the pixels on power of two grids, the closest coarser one covers this pixel
+    uvec2 pixel = uvec2(pixelIndex % m_size.x, pixelIndex / m_size.x);
+    for (u32 stride = 2; stride <= MAX_FILL_STRIDE; stride *= 2) {
+        uvec2 coarsePixel = pixel - pixel % stride;
+        u32 coarsePixelIndex = coarsePixel.y * m_size.x + coarsePixel.x;
+        if (m_sampleCount[coarsePixelIndex] != 0)
+            return coarsePixelIndex;
+    }
+
+    return pixelIndex;
+}
+
+f64 AccumulationBuffer::varianceOfMean(u32 pixelIndex) const {
+    u32 sampleCount = m_sampleCount[pixelIndex];
+    if (sampleCount < 2)
+        return INFINITY;
+
+    // Unbiased sample variance divided by the sample count
+    f64 luminanceSum = m_luminanceMoments[0][pixelIndex];
+    f64 variance = (m_luminanceMoments[1][pixelIndex] - luminanceSum * luminanceSum / sampleCount) / (sampleCount - 1);
+    return std::max(variance, 0.0) / sampleCount;
+}
+
+template <typename T, size_t L>
+Texture<T> AccumulationBuffer::resolveSums(const std::array<std::vector<f32>, L>& planes, bool fillUnsampled) const {
+    Texture<T> texture(m_size);
+    f32* data = reinterpret_cast<f32*>(texture.data());
+
+    NODEBUG_ONLY(_Pragma("omp parallel for"))
+    for (i32 i = 0; i < (i32)m_sampleCount.size(); i++) {
+        u32 source = fillUnsampled ? sampledPixel(i) : i;
+        f32 sampleCountInv = m_sampleCount[source] != 0 ? 1.0f / m_sampleCount[source] : 0.0f;
+        for (size_t j = 0; j < L; j++)
+            data[i * L + j] = planes[j][source] * sampleCountInv;
+    }
+
+    return texture;
+}
+
+Texture<vec3> AccumulationBuffer::resolveMeans(const std::array<std::vector<f32>, 3>& planes, const std::vector<u32>& sampleCounts,
+                                               bool fillUnsampled) const {
+    Texture<vec3> texture(m_size);
+    f32* data = reinterpret_cast<f32*>(texture.data());
+
+    NODEBUG_ONLY(_Pragma("omp parallel for"))
+    for (i32 i = 0; i < (i32)m_sampleCount.size(); i++) {
+        u32 source = fillUnsampled ? sampledPixel(i) : i;
+        f32 sampleCountInv = sampleCounts[source] != 0 ? 1.0f / sampleCounts[source] : NAN;
+        for (size_t j = 0; j < 3; j++)
+            data[i * 3 + j] = planes[j][source] * sampleCountInv;
+    }
+
+    return texture;
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "Texture.h"
+
+enum class OutputChannel : u32 {
+    Color = BIT(0),
+    Depth = BIT(1),
+    Normal = BIT(2),
+    Albedo = BIT(3),
+    Emission = BIT(4),
+    Variance = BIT(5),  // Variance of the color luminance mean, requires Color
+#ifdef BVH_TEST
+    AABBTestCount = BIT(6),
+    TriangleTestCount = BIT(7),
+#endif
+};
+
+#ifdef BVH_TEST
+constexpr u32 OUTPUT_CHANNEL_MASK = BIT(8) - 1;
+#else
+constexpr u32 OUTPUT_CHANNEL_MASK = BIT(6) - 1;
+#endif
+
+struct RenderOutput {
+    Texture<vec3> color;
+    Texture<f32> depth;
+    Texture<vec3> normal;
+    Texture<vec3> albedo;
+    Texture<vec3> emission;
+    Texture<f32> variance;
+#ifdef BVH_TEST
+    Texture<f32> aabbTestCount;
+    Texture<f32> triangleTestCount;
+#endif
+
+    // Metadata
+    u32 sampleCount = 0;       // Samples per pixel rendered
+    f32 estimatedError = NAN;  // Estimated RMSE of the color luminance, NaN without the variance channel
+    std::chrono::microseconds renderTime = std::chrono::microseconds(0);
+};
+
+struct PathSample {
+    vec3 color = vec3(0);
+    f32 depth = INFINITY;
+    vec3 normal = vec3(NAN);
+    vec3 albedo = vec3(NAN);
+    vec3 emission = vec3(NAN);
+#ifdef BVH_TEST
+    u32 aabbTestCount = NAN;
+    u32 triangleTestCount = NAN;
+#endif
+    u32 rayCount = 0;
+};
+
+/*
+ * @brief Per pixel accumulation of path samples, every channel component is stored in its own plane.
+ *
+ * Color, depth and emission are accumulated as f32 sums and only divided by the sample count on resolve.
+ * The luminance sums of the variance are f64.
+ * Normal and albedo are f32 sums as well, but they count their own samples, samples without a surface are left out of them.
+ */
+class AccumulationBuffer {
+public:
+    static constexpr u32 MAX_FILL_STRIDE = 64;  // Coarsest progressive grid unsampled pixels are filled from
+
+    AccumulationBuffer() = default;
+
+    AccumulationBuffer(const uvec2& size, u32 channels);
+
+    /*
+     * @brief Adds a sample to a pixel, only the channels in Channels are written.
+     * @param pixelIndex Linear index of the pixel.
+     * @param sample The sample to add.
+     */
+    template <u32 Channels>
+    inline void accumulate(u32 pixelIndex, const PathSample& sample) {
+        u32 sampleCount = ++m_sampleCount[pixelIndex];
+
+        if constexpr ((bool)(Channels & (u32)OutputChannel::Color))
+            addToSum(m_color, pixelIndex, glm::value_ptr(sample.color), sampleCount);
+        if constexpr ((bool)(Channels & (u32)OutputChannel::Depth))
+            addToSum(m_depth, pixelIndex, &sample.depth, sampleCount);
+        if constexpr ((bool)(Channels & (u32)OutputChannel::Normal))
+            addToMeanSum(m_normal, m_normalSampleCount[0], pixelIndex, glm::value_ptr(sample.normal));
+        if constexpr ((bool)(Channels & (u32)OutputChannel::Albedo))
+            addToMeanSum(m_albedo, m_albedoSampleCount[0], pixelIndex, glm::value_ptr(sample.albedo));
+        if constexpr ((bool)(Channels & (u32)OutputChannel::Emission))
+            addToSum(m_emission, pixelIndex, glm::value_ptr(sample.emission), sampleCount);
+        if constexpr ((bool)(Channels & (u32)OutputChannel::Variance) && (bool)(Channels & (u32)OutputChannel::Color)) {
+            f64 sampleLuminance = luminance(sample.color);
+            std::array<f64, 2> moments = {sampleLuminance, sampleLuminance * sampleLuminance};
+            addToSum(m_luminanceMoments, pixelIndex, moments.data(), sampleCount);
+        }
+#ifdef BVH_TEST
+        if constexpr ((bool)(Channels & (u32)OutputChannel::AABBTestCount)) {
+            f32 aabbTestCount = (f32)sample.aabbTestCount;
+            addToSum(m_aabbTestCount, pixelIndex, &aabbTestCount, sampleCount);
+        }
+        if constexpr ((bool)(Channels & (u32)OutputChannel::TriangleTestCount)) {
+            f32 triangleTestCount = (f32)sample.triangleTestCount;
+            addToSum(m_triangleTestCount, pixelIndex, &triangleTestCount, sampleCount);
+        }
+#endif
+    }
+
+    /*
+     * @brief Divides the sums by the sample counts.
+     * @param channels The channels to resolve, channels not present in the buffer are skipped.
+     * @param fillUnsampled Unsampled pixels take the value of the closest sampled pixel on a coarser power of two grid,
+     *                      used to preview progressive levels.
+     * @return Averaged textures of the requested channels, the other textures are left empty. The sample count and error
+     *         are left to the caller, see maxSampleCount and estimateError, previews don't need their passes over the buffer.
+     */
+    RenderOutput resolve(u32 channels = OUTPUT_CHANNEL_MASK, bool fillUnsampled = false) const;
+
+    /*
+     * @brief Adds the samples of another buffer of the same size and channels.
+     *
+     * Every channel, normal and albedo included, is a sum that is added in a different order than a single buffer would
+     * have added the samples, so the result matches a single buffer with the same samples only up to f32 rounding, a
+     * relative difference of at most about sampleCount * 2^-24 per pixel, far below the noise. Merging the same buffers
+     * in the same order gives the same result.
+     *
+     * @param other The buffer to merge into this one.
+     */
+    void merge(const AccumulationBuffer& other);
+
+    /*
+     * @brief Estimates the error of the resolved color from the per pixel luminance variance.
+     * @return Root mean square error of the pixel luminance means, NaN without the color and variance channels.
+     */
+    f32 estimateError() const;
+
+    /*
+     * @return Samples of the most sampled pixel.
+     */
+    u32 maxSampleCount() const;
+
+    /*
+     * @brief Calls f with every allocated plane, always in the same order, starting with the sample counts.
+     */
+    template <typename F>
+    void forEachPlane(F&& f) {
+        forEachPlaneImpl(*this, f);
+    }
+
+    template <typename F>
+    void forEachPlane(F&& f) const {
+        forEachPlaneImpl(*this, f);
+    }
+
+    inline const uvec2& size() const { return m_size; }
+
+    inline u32 channels() const { return m_channels; }
+
+    inline u32 sampleCount(u32 pixelIndex) const { return m_sampleCount[pixelIndex]; }
+
+private:
+    uvec2 m_size = uvec2(0);
+    u32 m_channels = 0;
+
+    std::vector<u32> m_sampleCount;
+    std::array<std::vector<f32>, 3> m_color;
+    std::array<std::vector<f32>, 1> m_depth;
+    std::array<std::vector<f32>, 3> m_normal;
+    std::array<std::vector<f32>, 3> m_albedo;
+    std::array<std::vector<u32>, 1> m_normalSampleCount;  // Samples in the normal sum, NaN samples are not counted
+    std::array<std::vector<u32>, 1> m_albedoSampleCount;
+    std::array<std::vector<f32>, 3> m_emission;
+    std::array<std::vector<f64>, 2> m_luminanceMoments;  // Sums of the color luminance and its square, f64 as their difference cancels most digits
+#ifdef BVH_TEST
+    std::array<std::vector<f32>, 1> m_aabbTestCount;
+    std::array<std::vector<f32>, 1> m_triangleTestCount;
+#endif
+
+    // NaN samples are replaced by the current mean
+    template <typename T, size_t L>
+    static inline void addToSum(std::array<std::vector<T>, L>& planes, u32 pixelIndex, const T* value, u32 sampleCount) {
+        bool isNan = false;
+        for (size_t i = 0; i < L; i++)
+            isNan |= std::isnan(value[i]);
+
+        if (!isNan) {
+            for (size_t i = 0; i < L; i++)
+                planes[i][pixelIndex] += value[i];
+        }
+        else if (sampleCount > 1) {
+            for (size_t i = 0; i < L; i++)
+                planes[i][pixelIndex] += planes[i][pixelIndex] / (T)(sampleCount - 1);
+        }
+    }
+
+    // NaN samples are skipped and not counted, the mean stays NaN until the first valid sample
+    template <size_t L>
+    static inline void addToMeanSum(std::array<std::vector<f32>, L>& planes, std::vector<u32>& sampleCounts, u32 pixelIndex, const f32* value) {
+        bool isNan = false;
+        for (size_t i = 0; i < L; i++)
+            isNan |= std::isnan(value[i]);
+
+        if (isNan)
+            return;
+
+        sampleCounts[pixelIndex]++;
+        for (size_t i = 0; i < L; i++)
+            planes[i][pixelIndex] += value[i];
+    }
+
+    template <typename Self, typename F>
+    static void forEachPlaneImpl(Self& self, F& f) {
+        f(self.m_sampleCount);
+
+        auto visit = [&](auto& planes, OutputChannel channel) {
+            if (self.m_channels & (u32)channel) {
+                for (auto& plane : planes)
+                    f(plane);
+            }
+        };
+
+        visit(self.m_color, OutputChannel::Color);
+        visit(self.m_depth, OutputChannel::Depth);
+        visit(self.m_normal, OutputChannel::Normal);
+        visit(self.m_normalSampleCount, OutputChannel::Normal);
+        visit(self.m_albedo, OutputChannel::Albedo);
+        visit(self.m_albedoSampleCount, OutputChannel::Albedo);
+        visit(self.m_emission, OutputChannel::Emission);
+        visit(self.m_luminanceMoments, OutputChannel::Variance);
+#ifdef BVH_TEST
+        visit(self.m_aabbTestCount, OutputChannel::AABBTestCount);
+        visit(self.m_triangleTestCount, OutputChannel::TriangleTestCount);
+#endif
+    }
+
+    template <typename T, size_t L>
+    Texture<T> resolveSums(const std::array<std::vector<f32>, L>& planes, bool fillUnsampled) const;
+
+    Texture<vec3> resolveMeans(const std::array<std::vector<f32>, 3>& planes, const std::vector<u32>& sampleCounts, bool fillUnsampled) const;
+
+    f64 varianceOfMean(u32 pixelIndex) const;
+
+    u32 sampledPixel(u32 pixelIndex) const;
+};
@@ -3,10 +3,24 @@
 #include "Mesh.h"
 
 HitRecord BVH::intersect(Ray& ray, bool backfaceCulling) const {
+    if (!isBuilt())
+        return HitRecord();
+
+    if (m_pagedFile)
+        return intersectImpl<true>(m_pagedNodes.data(), m_pagedTriangles.data(), m_pagedVertices.data(), ray, backfaceCulling);
+
+    return intersectImpl<false>(m_nodes.data(), m_triangles.data(), m_vertices.data(), ray, backfaceCulling);
+}
+
+template <bool Paged>
+HitRecord BVH::intersectImpl(const Node* nodes, const Triangle* triangles, const vec3* vertices, Ray& ray, bool backfaceCulling) const {
     HitRecord hit;
 
-    if (m_nodes.empty())
-        return hit;
+    // Paged BVHs read through the mapped file, every read is reported to the page cache first
+    auto touch = [&]([[maybe_unused]] const void* address) {
+        if constexpr (Paged)
+            m_pagedFile->touch(address);
+    };
 
     RayShearConstants raySheerConstants(ray.direction);
 
@@ -16,7 +30,8 @@ HitRecord BVH::intersect(Ray& ray, bool backfaceCulling) const {
 
     while (stackSize != 0) {
         u32 nodeIndex = stack[--stackSize];
-        const Node& node = m_nodes[nodeIndex];
+        const Node& node = nodes[nodeIndex];
+        touch(&node);
 
 #ifdef BVH_TEST
         ray.aabbTestCount++;
@@ -27,16 +42,22 @@ HitRecord BVH::intersect(Ray& ray, bool backfaceCulling) const {
             continue;
 
         if (node.triangleCount != 0) {
-            // Leaf node
+            // Leaf node, its triangles span at most two pages
+            touch(&triangles[node.triangleIndex]);
+            touch(&triangles[node.triangleIndex + node.triangleCount - 1]);
+
             for (u32 i = node.triangleIndex; i < node.triangleIndex + node.triangleCount; i++) {
-                const Triangle& triangle = m_triangles.at(i);
+                const Triangle& triangle = triangles[i];
 
 #ifdef BVH_TEST
                 ray.triangleTestCount++;
 #endif
 
                 const auto& vertexIds = triangle.vertexIds;
-                auto [t, barycentric] = rayTriangleIntersectionWT(ray.origin, raySheerConstants, m_vertices[vertexIds[0]], m_vertices[vertexIds[1]], m_vertices[vertexIds[2]], backfaceCulling);
+                for (u32 vertexId : vertexIds)
+                    touch(&vertices[vertexId]);
+
+                auto [t, barycentric] = rayTriangleIntersectionWT(ray.origin, raySheerConstants, vertices[vertexIds[0]], vertices[vertexIds[1]], vertices[vertexIds[2]], backfaceCulling);
                 if (!std::isnan(t) && ray.tInterval.surrounds(t)) {
                     hit.hit = true;
                     hit.triangleId = i;
@@ -49,11 +70,14 @@ HitRecord BVH::intersect(Ray& ray, bool backfaceCulling) const {
         }
 
         // Add children to stack sorted by tNear
-        const Node& leftNode = m_nodes[node.childIndex];
+        const Node& leftNode = nodes[node.childIndex];
+        const Node& rightNode = nodes[node.childIndex + 1];
+        touch(&leftNode);
+        touch(&rightNode);
+
         auto leftNodeIntersection = rayAABBintersection(ray.origin, ray.invDirection, leftNode.aabb);
         bool leftNodeHit = !std::isnan(leftNodeIntersection.min) && ray.tInterval.intersection(leftNodeIntersection).length() >= 0;
 
-        const Node& rightNode = m_nodes[node.childIndex + 1];
         auto rightNodeIntersection = rayAABBintersection(ray.origin, ray.invDirection, rightNode.aabb);
         bool rightNodeHit = !std::isnan(rightNodeIntersection.min) && ray.tInterval.intersection(rightNodeIntersection).length() >= 0;
 
@@ -136,6 +160,48 @@ void BVH::build(u32 perAxisSplitTests) {
     m_stats.nodeCount = (u32)m_nodes.size();
 }
 
+void BVH::setNodes(std::vector<Node>&& nodes) {
+    m_nodes = std::move(nodes);
+    m_stats = Stats();
+    m_stats.buildTime = std::chrono::microseconds(0);
+    m_stats.triangleCount = (u32)m_triangles.size();
+    m_stats.nodeCount = (u32)m_nodes.size();
+
+    if (m_nodes.empty())
+        return;
+
+    std::vector<std::pair<u32, u32>> stack = {{0, 1}};
+    while (!stack.empty()) {
+        auto [nodeIndex, depth] = stack.back();
+        stack.pop_back();
+        m_stats.maxDepth = std::max(m_stats.maxDepth, depth);
+
+        const Node& node = m_nodes[nodeIndex];
+        if (node.triangleCount != 0) {
+            m_stats.leafCount++;
+            m_stats.maxTrianglesPerLeaf = std::max(m_stats.maxTrianglesPerLeaf, node.triangleCount);
+            continue;
+        }
+
+        stack.push_back({node.childIndex, depth + 1});
+        stack.push_back({node.childIndex + 1, depth + 1});
+    }
+}
+
+void BVH::setPaged(std::span<const Node> nodes, std::span<const Triangle> triangles, std::span<const vec3> vertices, Ref<PageCache::PagedFile> pagedFile) {
+    m_nodes = {};
+    m_pagedNodes = nodes;
+    m_pagedTriangles = triangles;
+    m_pagedVertices = vertices;
+    m_pagedFile = std::move(pagedFile);
+
+    m_stats = Stats();
+    m_stats.buildTime = std::chrono::microseconds(0);
+    m_stats.triangleCount = (u32)triangles.size();
+    m_stats.nodeCount = (u32)nodes.size();
+    m_stats.leafCount = ((u32)nodes.size() + 1) / 2;  // Every inner node has two children
+}
+
 bool BVH::splitNode(u32 nodeIndex, std::vector<AABB>& triangleAABBs) {
     Node& parentNode = m_nodes[nodeIndex];
 
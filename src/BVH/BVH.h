@@ -1,17 +1,32 @@
 #pragma once
 
+#include <span>
+
 #include "HitRecord.h"
+#include "PageCache.h"
 #include "Ray.h"
 
 constexpr u32 BVH_MAX_DEPTH = 128;
 constexpr u32 BVH_MAX_TRIANGLES_PER_LEAF = 32;
 
-struct Triangle;
+struct Triangle {
+    std::array<u32, 3> vertexIds;
+    u32 materialId;
+};
 
 class BVH {
 public:
     BVH(std::vector<vec3>& vertices, std::vector<Triangle>& triangles) : m_vertices(vertices), m_triangles(triangles) {}
 
+    struct Node {
+        AABB aabb;
+        u32 triangleCount;
+        union {                 // Either triangleIndex or childIndex if triangleCount == 0
+            u32 triangleIndex;  // First triangle
+            u32 childIndex;     // Left child
+        };
+    };
+
     struct Stats {
         std::chrono::microseconds buildTime;
         u32 triangleCount = 0;
@@ -25,20 +40,26 @@ public:
 
     void build(u32 perAxisSplitTests = 32);
 
-    bool isBuilt() const { return !m_nodes.empty(); }
+    /*
+     * @brief Takes the nodes of a BVH built earlier over the same, already reordered, triangles.
+     */
+    void setNodes(std::vector<Node>&& nodes);
+
+    /*
+     * @brief Reads the nodes, triangles and vertices from a paged file instead of the vectors, which stay empty.
+     *
+     * Every read touches its page first, so the pages are tracked by the page cache. The depth and leaf size stats are left 0,
+     * they would need every node paged in.
+     */
+    void setPaged(std::span<const Node> nodes, std::span<const Triangle> triangles, std::span<const vec3> vertices, Ref<PageCache::PagedFile> pagedFile);
+
+    bool isBuilt() const { return !m_nodes.empty() || !m_pagedNodes.empty(); }
+
+    const std::vector<Node>& nodes() const { return m_nodes; }
 
     const Stats& stats() const { return m_stats; }
 
 private:
-    struct Node {
-        AABB aabb;
-        u32 triangleCount;
-        union {                 // Either triangleIndex or childIndex if triangleCount == 0
-            u32 triangleIndex;  // First triangle
-            u32 childIndex;     // Left child
-        };
-    };
-
     struct SplitData {
         bool shouldSplit;
         u32 splitAxis;
@@ -52,8 +73,17 @@ private:
     std::vector<Node> m_nodes;
     u32 m_perAxisSplitTests = 8;
 
+    Ref<PageCache::PagedFile> m_pagedFile;
+    std::span<const Node> m_pagedNodes;
+    std::span<const Triangle> m_pagedTriangles;
+    std::span<const vec3> m_pagedVertices;
+
     Stats m_stats;
 
+    // Out of core traversal touches every read, compiled separately so the in core one has no overhead
+    template <bool Paged>
+    HitRecord intersectImpl(const Node* nodes, const Triangle* triangles, const vec3* vertices, Ray& ray, bool backfaceCulling) const;
+
     bool splitNode(u32 nodeIndex, std::vector<AABB>& triangleAABBs);
 
     SplitData findBestSplit(u32 nodeIndex, const std::vector<AABB>& triangleAABBs) const;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Ray.h"
+#include "Sampler.h"
 
 class Renderer;
 
@@ -14,18 +15,21 @@ public:
     f32 m_defocusAngle = 0.0f;
     f32 m_focusDistance = 10.0f;
 
-    Ray createRay(const uvec2& pixel, const vec2& sample) const {
+    Ray createRay(const uvec2& pixel, Sampler& sampler) const {
+        vec2 sample = sampler.getPixel2D();
         vec3 pixelOrigin = m_pixelGridOrigin + (f32)pixel.x * m_pixelDeltaU + (f32)pixel.y * m_pixelDeltaV;
         vec3 samplePoint = pixelOrigin + sample.x * m_pixelDeltaU + sample.y * m_pixelDeltaV;
         vec3 rayOrigin = m_position;
 
         if (m_defocusAngle > 0) {
             // Random position in defocus disk
-            vec2 random = randomVec2InUnitDisk();
+            vec2 random = squareToUnitDisk(sampler.get2D());
             rayOrigin += m_defocusDiskU * random.x + m_defocusDiskV * random.y;
         }
 
-        return Ray(rayOrigin, glm::normalize(samplePoint - rayOrigin));
+        Ray ray(rayOrigin, glm::normalize(samplePoint - rayOrigin));
+        ray.coneSpread = m_pixelSpreadAngle;
+        return ray;
     }
 
 private:
@@ -35,6 +39,7 @@ private:
     vec3 m_pixelGridOrigin = vec3(0);
     vec3 m_defocusDiskU = vec3(0);
     vec3 m_defocusDiskV = vec3(0);
+    f32 m_pixelSpreadAngle = 0;
 
     friend class Renderer;
 
@@ -53,6 +58,7 @@ private:
         m_pixelDeltaU = viewportU / static_cast<f32>(imageSize.x);
         m_pixelDeltaV = viewportV / static_cast<f32>(imageSize.y);
         m_pixelGridOrigin = m_position - m_focusDistance * w - viewportU / 2.0f - viewportV / 2.0f;
+        m_pixelSpreadAngle = m_viewportSize.y / (imageSize.y * m_focusDistance);  // Angle covered by one pixel
 
         auto defocusRadius = m_focusDistance * tan(glm::radians(m_defocusAngle / 2));
         m_defocusDiskU = defocusRadius * u;
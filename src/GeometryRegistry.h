@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Mesh.h"
+#include "SharedRegistry.h"
+
+/*
+ * @brief Shares loaded geometry and its BVH between meshes, like repeated assets or an OBJ loaded again.
+ *
+ * Geometry is registered under two kinds of keys, see sourceKey and contentKey:
+ *  - Loads of the same source reserve it before reading or parsing anything, concurrent loads wait for the first one.
+ *  - Geometry of the same content loaded from other sources is shared once loaded, if its array sizes match too.
+ * The registry only keeps weak references, a geometry is freed once no mesh uses it.
+ */
+class GeometryRegistry : public SharedRegistry<MeshGeometry> {
+public:
+    /*
+     * @brief Key of a source file, changes when the file is modified.
+     * @param materialCount Materials of the source, triangles without one use the default material after them.
+     */
+    static std::string sourceKey(const std::filesystem::path& filePath, u32 materialCount, VertexFormat vertexFormat, bool isPaged) {
+        std::error_code timeError;
+        auto writeTime = std::filesystem::last_write_time(filePath, timeError);
+        return std::format("source|{}|{}|{}|{}|{}", std::filesystem::weakly_canonical(filePath).string(), (i64)writeTime.time_since_epoch().count(), materialCount, (u32)vertexFormat, isPaged);
+    }
+
+    /*
+     * @param contentHash Hash of the full format arrays and BVH nodes, as in the geometry file.
+     */
+    static std::string contentKey(u64 contentHash, VertexFormat vertexFormat, bool isPaged) {
+        return std::format("content|{:016x}|{}|{}", contentHash, (u32)vertexFormat, isPaged);
+    }
+
+    /*
+     * @brief Returns the geometry registered under a content key, null if there is none or its array sizes differ from the expected ones.
+     */
+    Ref<MeshGeometry> find(const std::string& key, size_t vertexCount, size_t triangleCount) {
+        // A 64 bit hash alone could match geometry of other content
+        return SharedRegistry::find(key, [&](const MeshGeometry& geometry) {
+            return geometry.vertexCount() == vertexCount && geometry.triangleCount() == triangleCount;
+        });
+    }
+
+    /*
+     * @brief Registers geometry the caller loaded under its content key, a still used geometry of the same key is kept instead.
+     */
+    void add(const std::string& key, const Ref<MeshGeometry>& geometry) {
+        SharedRegistry::add(key, geometry, geometry->dataSize());
+    }
+};
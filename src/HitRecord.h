@@ -11,6 +11,7 @@ struct HitRecord {
     vec3 tangent = vec3(0);
     vec3 bitangent = vec3(0);
     vec3 barycentric = vec3(0);
+    f32 uvFootprint = 0;  // Width of the ray cone in uv units, 0 if unknown
     Ref<const Material> material;
 
     vec3 point;  // Set just before scattering
@@ -34,13 +34,15 @@ public:
         return hit;
     }
 
-    void frameBegin() override {
-        m_transform.updateMatrices();
+    bool frameBegin() override {
+        bool changed = m_transform.updateMatrices();
         m_normal = m_transform.modelMatrix() * vec4(VEC_UP, 0.0f);
         m_origin = m_transform.position();
         m_u = m_transform.modelMatrix() * vec4(VEC_RIGHT * m_size.x, 0.0f);
         m_v = m_transform.modelMatrix() * vec4(VEC_FORWARD * m_size.y, 0.0f);
         m_uvLength2Inv = 1.0f / vec2(glm::length2(m_u), glm::length2(m_v));
+
+        return changed;
     }
 
 private:
@@ -28,11 +28,16 @@ public:
         return hit;
     }
 
-    void frameBegin() override {
+    bool frameBegin() override {
+        bool changed = false;
         for (size_t i = 0; i < m_hittables.size(); i++)
-            m_hittables[i]->frameBegin();
+            changed |= m_hittables[i]->frameBegin();
+
+        return changed;
     }
 
+    const std::vector<Ref<IHittable>>& hittables() const { return m_hittables; }
+
 private:
     std::vector<Ref<IHittable>> m_hittables;
 };
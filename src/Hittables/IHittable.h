@@ -7,5 +7,9 @@ class IHittable {
 public:
     virtual HitRecord hit(Ray& ray) const = 0;
 
-    virtual void frameBegin() {}
+    /*
+     * @brief Prepares the hittable for rendering a frame.
+     * @return True if the geometry changed since the last frame.
+     */
+    virtual bool frameBegin() { return false; }
 };
@@ -3,6 +3,7 @@
 #include "IHittable.h"
 #include "Material.h"
 #include "Mesh.h"
+#include "ThreadPool.h"
 
 class Model : public IHittable {
 public:
@@ -19,35 +20,44 @@ public:
 
         // Calculate interpolated normal and uv
         if (hit.hit) {
-            assert(hit.triangleId >= 0 && hit.triangleId < m_mesh.geometry->triangles.size());
+            const auto& geometry = *m_mesh.geometry;
+            assert(hit.triangleId >= 0 && hit.triangleId < geometry.triangleCount());
 
-            hit.material = m_mesh.materials[m_mesh.geometry->triangles[hit.triangleId].materialId];
+            const auto& triangle = geometry.triangle(hit.triangleId);
+            hit.material = m_mesh.materials[triangle.materialId];
             hit.geometry = m_mesh.geometry;
 
-            const auto& triangle = m_mesh.geometry->triangles[hit.triangleId];
             const auto& vertexIds = triangle.vertexIds;
-            const auto& vertices = m_mesh.geometry->vertices;
-            const auto& uvs = m_mesh.geometry->uvs;
-            const auto& normals = m_mesh.geometry->normals;
-            const auto& tangents = m_mesh.geometry->tangents;
+            std::array<vec3, 3> vertices = {geometry.vertex(vertexIds[0]), geometry.vertex(vertexIds[1]), geometry.vertex(vertexIds[2])};
 
-            if (!uvs.empty()) {
-                vec2 interpolatedUV = hit.barycentric.x * uvs[vertexIds[0]] + hit.barycentric.y * uvs[vertexIds[1]] + hit.barycentric.z * uvs[vertexIds[2]];
+            // Quantized attributes are decoded here, only for the vertices of the hit triangle
+            if (geometry.hasUVs()) {
+                std::array<vec2, 3> uvs = {geometry.uv(vertexIds[0]), geometry.uv(vertexIds[1]), geometry.uv(vertexIds[2])};
+                vec2 interpolatedUV = hit.barycentric.x * uvs[0] + hit.barycentric.y * uvs[1] + hit.barycentric.z * uvs[2];
                 hit.uv = interpolatedUV;
+
+                // Ray cone footprint projected into uv space by the triangle's uv to surface area ratio
+                f32 uvArea = std::abs(cross(uvs[1] - uvs[0], uvs[2] - uvs[0]));
+                vec3 surfaceCross = glm::cross(vertices[1] - vertices[0], vertices[2] - vertices[0]);
+                f32 surfaceArea = glm::length(surfaceCross);
+                f32 cosine = std::abs(glm::dot(ray.direction, surfaceCross)) / surfaceArea;
+                if (surfaceArea > 0 && cosine > 0)
+                    hit.uvFootprint = ray.coneWidthAt(ray.tInterval.max) * std::sqrt(uvArea / surfaceArea) / cosine;
             }
 
-            if (!normals.empty()) {
-                vec3 interpolatedNormal = hit.barycentric.x * normals[vertexIds[0]] + hit.barycentric.y * normals[vertexIds[1]] + hit.barycentric.z * normals[vertexIds[2]];
+            if (geometry.hasNormals()) {
+                vec3 interpolatedNormal = hit.barycentric.x * geometry.normal(vertexIds[0]) + hit.barycentric.y * geometry.normal(vertexIds[1]) + hit.barycentric.z * geometry.normal(vertexIds[2]);
                 hit.normal = glm::normalize(interpolatedNormal);
             }
             else {
-                vec3 flatNormal = glm::cross(vertices[vertexIds[1]] - vertices[vertexIds[0]], vertices[vertexIds[2]] - vertices[vertexIds[0]]);
+                vec3 flatNormal = glm::cross(vertices[1] - vertices[0], vertices[2] - vertices[0]);
                 hit.normal = glm::normalize(flatNormal);
             }
 
-            if (!tangents.empty()) {
-                vec3 interpolatedTangent = hit.barycentric.x * vec3(tangents[vertexIds[0]]) + hit.barycentric.y * vec3(tangents[vertexIds[1]]) + hit.barycentric.z * vec3(tangents[vertexIds[2]]);
-                f32 handedness = tangents[vertexIds[0]].w;
+            if (geometry.hasTangents()) {
+                std::array<vec4, 3> tangents = {geometry.tangent(vertexIds[0]), geometry.tangent(vertexIds[1]), geometry.tangent(vertexIds[2])};
+                vec3 interpolatedTangent = hit.barycentric.x * vec3(tangents[0]) + hit.barycentric.y * vec3(tangents[1]) + hit.barycentric.z * vec3(tangents[2]);
+                f32 handedness = tangents[0].w;
 
                 hit.tangent = glm::normalize(interpolatedTangent - glm::dot(interpolatedTangent, hit.normal) * hit.normal);  // Reorthogonalize after normal interpolation
                 hit.bitangent = handedness * glm::cross(hit.normal, hit.tangent);
@@ -57,9 +67,31 @@ public:
         return hit;
     }
 
-    void frameBegin() override {
-        if (!m_mesh.geometry->bvh.isBuilt()) {  // TODO paralelize - mutex in bvh
-            m_mesh.geometry->bvh.build();
+    /*
+     * @brief Starts building the BVH on the pool, frameBegin waits for it to finish.
+     * @param onBuilt Called on the pool once the BVH is built, before any frame, so it may still modify the geometry.
+     */
+    void buildBVHAsync(ThreadPool& pool, std::function<void(MeshGeometry&)> onBuilt = nullptr) {
+        if (m_mesh.geometry->bvh.isBuilt() || m_bvhBuild.valid())
+            return;
+
+        auto build = [geometry = m_mesh.geometry, onBuilt = std::move(onBuilt)] {
+            geometry->bvh.build();
+            if (onBuilt)
+                onBuilt(*geometry);
+        };
+        m_bvhBuild = pool.submit(std::move(build)).share();
+    }
+
+    bool frameBegin() override {
+        bool changed = false;
+        if (!m_isBVHReady) {  // BVHs built or loaded elsewhere are only reported here
+            if (m_bvhBuild.valid()) {
+                m_bvhBuild.get();
+                m_bvhBuild = {};
+            }
+            else if (!m_mesh.geometry->bvh.isBuilt())  // TODO paralelize - mutex in bvh
+                m_mesh.geometry->bvh.build();
 
             const auto& stats = m_mesh.geometry->bvh.stats();
             LOG(std::format(
@@ -72,9 +104,17 @@ public:
                 stats.maxDepth,
                 (f32)stats.triangleCount / stats.leafCount,
                 stats.maxTrianglesPerLeaf));
+            m_isBVHReady = true;
+            changed = true;
         }
 
         for (const auto& material : m_mesh.materials)
             m_backfaceCulling &= material->backfaceCulling && material->scatterFunction != dielectricScatter;
+
+        return changed;
     }
+
+private:
+    std::shared_future<void> m_bvhBuild;  // Valid while an asynchronous build hasn't been waited for
+    bool m_isBVHReady = false;
 };
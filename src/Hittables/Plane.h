@@ -35,13 +35,15 @@ public:
         return hit;
     }
 
-    void frameBegin() override {
-        m_transform.updateMatrices();
+    bool frameBegin() override {
+        bool changed = m_transform.updateMatrices();
         m_normal = m_transform.up();
         m_origin = m_transform.position();
         m_u = m_transform.modelMatrix() * vec4(VEC_RIGHT, 0.0f) * (isinf(m_size.x) ? 1.0f : m_size.x);
         m_v = m_transform.modelMatrix() * vec4(VEC_FORWARD, 0.0f) * (isinf(m_size.x) ? 1.0f : m_size.y);
         m_uvLength2Inv = 1.0f / vec2(glm::length2(m_u), glm::length2(m_v));
+
+        return changed;
     }
 
 private:
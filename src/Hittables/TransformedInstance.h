@@ -22,8 +22,10 @@ public:
         return hit;
     }
 
-    void frameBegin() override {
-        m_transform.updateMatrices();
-        m_hittable->frameBegin();
+    bool frameBegin() override {
+        // Moving the instance only updates its matrices, the geometry below stays untouched
+        bool changed = m_transform.updateMatrices();
+        changed |= m_hittable->frameBegin();
+        return changed;
     }
 };
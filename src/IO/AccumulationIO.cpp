@@ -0,0 +1,105 @@
+#include "AccumulationIO.h"
+
+#include <fstream>
+
+constexpr u32 ACCUMULATION_FILE_MAGIC = 0x43414c4c;  // "LLAC"
+// 2: header fields written one by one, sample counts of the means
+// 3: output channel bits renumbered, older files would read their planes into the wrong channels
+// 4: f64 luminance sums of the variance
+// 5: f32 normal and albedo sums instead of half means
+constexpr u32 ACCUMULATION_FILE_VERSION = 5;
+
+void writeAccumulation(const std::filesystem::path& filePath, const AccumulationBuffer& accumulation, const AccumulationInfo& info) {
+    LOG("Saving accumulation " << filePath);
+
+    std::ofstream file(filePath, std::ios::binary);
+    if (!file) {
+        LOG("Saving accumulation failed");
+        throw std::runtime_error("Saving accumulation failed");
+    }
+
+    auto writeValue = [&](const auto& value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+
+    // Fields are written one by one, so the struct padding never ends up in the file
+    writeValue(ACCUMULATION_FILE_MAGIC);
+    writeValue(ACCUMULATION_FILE_VERSION);
+    writeValue(info.seed);
+    writeValue((u32)info.samplerType);
+    writeValue(info.totalSamples);
+    writeValue(info.partitionIndex);
+    writeValue(info.partitionCount);
+    writeValue(info.completedSamples);
+    writeValue(accumulation.size().x);
+    writeValue(accumulation.size().y);
+    writeValue(accumulation.channels());
+
+    accumulation.forEachPlane([&](const auto& plane) {
+        file.write(reinterpret_cast<const char*>(plane.data()), plane.size() * sizeof(plane[0]));
+    });
+
+    if (!file) {
+        LOG("Saving accumulation failed");
+        throw std::runtime_error("Saving accumulation failed");
+    }
+}
+
+std::pair<AccumulationBuffer, AccumulationInfo> loadAccumulation(const std::filesystem::path& filePath) {
+    LOG("Loading accumulation " << filePath);
+
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        LOG("Failed to load accumulation " << filePath);
+        throw std::runtime_error("Failed to load accumulation");
+    }
+
+    auto readValue = [&](auto& value) {
+        file.read(reinterpret_cast<char*>(&value), sizeof(value));
+    };
+
+    u32 magic = 0, version = 0;
+    readValue(magic);
+    readValue(version);
+    if (magic != ACCUMULATION_FILE_MAGIC || version != ACCUMULATION_FILE_VERSION) {
+        LOG("Invalid accumulation file");
+        throw std::runtime_error("Invalid accumulation file");
+    }
+
+    AccumulationInfo info;
+    u32 samplerType = 0;
+    uvec2 size;
+    u32 channels = 0;
+    readValue(info.seed);
+    readValue(samplerType);
+    readValue(info.totalSamples);
+    readValue(info.partitionIndex);
+    readValue(info.partitionCount);
+    readValue(info.completedSamples);
+    readValue(size.x);
+    readValue(size.y);
+    readValue(channels);
+    info.samplerType = (SamplerType)samplerType;
+
+    if (!file || samplerType > (u32)SamplerType::Sobol || info.partitionCount == 0 || info.partitionIndex >= info.partitionCount) {
+        LOG("Invalid accumulation file");
+        throw std::runtime_error("Invalid accumulation file");
+    }
+
+    if (channels & ~OUTPUT_CHANNEL_MASK) {
+        LOG("Accumulation file contains unsupported channels");
+        throw std::runtime_error("Invalid accumulation file");
+    }
+
+    AccumulationBuffer accumulation(size, channels);
+    accumulation.forEachPlane([&](auto& plane) {
+        file.read(reinterpret_cast<char*>(plane.data()), plane.size() * sizeof(plane[0]));
+    });
+
+    if (!file) {
+        LOG("Accumulation file is truncated");
+        throw std::runtime_error("Invalid accumulation file");
+    }
+
+    return {std::move(accumulation), info};
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "AccumulationBuffer.h"
+#include "Sampler.h"
+
+/*
+ * @brief Describes which samples of a frame an accumulation file contains.
+ */
+struct AccumulationInfo {
+    u64 seed = 0;
+    SamplerType samplerType = SamplerType::Sobol;
+    u32 totalSamples = 0;      // Samples of the whole frame
+    u32 partitionIndex = 0;    // Sample partition of this buffer
+    u32 partitionCount = 1;    // Number of partitions the frame is split into
+    u32 completedSamples = 0;  // Samples of the partition already accumulated
+};
+
+void writeAccumulation(const std::filesystem::path& filePath, const AccumulationBuffer& accumulation, const AccumulationInfo& info);
+
+std::pair<AccumulationBuffer, AccumulationInfo> loadAccumulation(const std::filesystem::path& filePath);
@@ -0,0 +1,277 @@
+#include "GeometryIO.h"
+
+#include <fstream>
+#include <thread>
+
+#include "MappedFile.h"
+
+constexpr u32 GEOMETRY_FILE_MAGIC = 0x4d47574c;  // "LWGM"
+constexpr u32 GEOMETRY_FILE_VERSION = 2;  // 2: welded and reordered vertices
+constexpr u64 GEOMETRY_ARRAY_ALIGNMENT = 64;
+constexpr u64 FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+constexpr u64 FNV_PRIME = 0x100000001b3;
+constexpr size_t RESIDENT_BVH_SIZE = 4 << 20;  // Bytes of the top BVH nodes pinned in out of core geometry, the nodes are in breadth first order
+
+// Arrays of the file, in file order
+enum GeometryArray : u32 {
+    Vertices,
+    UVs,
+    Normals,
+    Tangents,
+    Triangles,
+    BVHNodes,
+    GeometryArrayCount,
+};
+
+struct GeometryFileHeader {
+    u32 magic;
+    u32 version;
+    u32 materialCount;
+    u32 reserved;
+    u64 contentHash;
+    std::array<u64, GeometryArrayCount> offsets;  // Aligned to GEOMETRY_ARRAY_ALIGNMENT
+    std::array<u64, GeometryArrayCount> counts;
+};
+
+static_assert(std::is_trivially_copyable_v<Triangle> && std::is_trivially_copyable_v<BVH::Node>);
+
+struct ArrayData {
+    const void* data;
+    size_t elementSize;
+    size_t count;
+};
+
+static std::array<ArrayData, GeometryArrayCount> geometryArrays(const MeshGeometry& geometry) {
+    auto arrayData = [](const auto& vector) { return ArrayData{vector.data(), sizeof(vector[0]), vector.size()}; };
+    return {
+        arrayData(geometry.vertices),
+        arrayData(geometry.uvs),
+        arrayData(geometry.normals),
+        arrayData(geometry.tangents),
+        arrayData(geometry.triangles),
+        arrayData(geometry.bvh.nodes()),
+    };
+}
+
+// FNV-1a
+static u64 hashBytes(const void* data, size_t size, u64 hash = FNV_OFFSET_BASIS) {
+    const u8* bytes = static_cast<const u8*>(data);
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    return hash;
+}
+
+u64 geometryContentHash(const MeshGeometry& geometry) {
+    u64 hash = FNV_OFFSET_BASIS;
+    for (const auto& array : geometryArrays(geometry))
+        hash = hashBytes(array.data, array.count * array.elementSize, hash);
+    return hash;
+}
+
+u64 writeGeometry(const std::filesystem::path& filePath, const MeshGeometry& geometry, u32 materialCount) {
+    LOG("Saving geometry " << filePath);
+
+    if (!geometry.bvh.isBuilt()) {
+        LOG("Saving geometry without a built BVH");
+        throw std::runtime_error("Saving geometry without a built BVH");
+    }
+
+    if (geometry.vertexFormat != VertexFormat::Full) {
+        LOG("Saving quantized geometry");
+        throw std::runtime_error("Saving quantized geometry");
+    }
+
+    auto arrays = geometryArrays(geometry);
+
+    GeometryFileHeader header = {
+        .magic = GEOMETRY_FILE_MAGIC,
+        .version = GEOMETRY_FILE_VERSION,
+        .materialCount = materialCount,
+        .reserved = 0,
+        .contentHash = FNV_OFFSET_BASIS,
+    };
+
+    u64 offset = (sizeof(header) + GEOMETRY_ARRAY_ALIGNMENT - 1) / GEOMETRY_ARRAY_ALIGNMENT * GEOMETRY_ARRAY_ALIGNMENT;
+    for (u32 i = 0; i < GeometryArrayCount; i++) {
+        header.offsets[i] = offset;
+        header.counts[i] = arrays[i].count;
+        header.contentHash = hashBytes(arrays[i].data, arrays[i].count * arrays[i].elementSize, header.contentHash);
+        offset += (arrays[i].count * arrays[i].elementSize + GEOMETRY_ARRAY_ALIGNMENT - 1) / GEOMETRY_ARRAY_ALIGNMENT * GEOMETRY_ARRAY_ALIGNMENT;
+    }
+
+    // Written through a temporary file, so concurrent loads and crashes never see a partial file
+    std::filesystem::create_directories(filePath.parent_path());
+    auto temporaryPath = std::filesystem::path(filePath).concat(std::format(".{:x}.tmp", (u64)std::hash<std::thread::id>()(std::this_thread::get_id())));
+    {
+        std::ofstream file(temporaryPath, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (u32 i = 0; i < GeometryArrayCount; i++) {
+            file.seekp(header.offsets[i]);
+            file.write(static_cast<const char*>(arrays[i].data), arrays[i].count * arrays[i].elementSize);
+        }
+
+        if (!file) {
+            LOG("Saving geometry failed");
+            throw std::runtime_error("Saving geometry failed");
+        }
+    }
+    std::filesystem::rename(temporaryPath, filePath);
+    return header.contentHash;
+}
+
+// Missing files are outdated too
+static bool isOutdated(const std::filesystem::path& filePath, std::span<const std::filesystem::path> sourcePaths) {
+    std::error_code fileError;
+    auto fileTime = std::filesystem::last_write_time(filePath, fileError);
+    if (fileError)
+        return true;
+
+    for (const auto& sourcePath : sourcePaths) {
+        std::error_code sourceError;
+        auto sourceTime = std::filesystem::last_write_time(sourcePath, sourceError);
+        if (!sourceError && fileTime < sourceTime)
+            return true;
+    }
+    return false;
+}
+
+std::optional<GeometryFile> readGeometryHeader(const std::filesystem::path& filePath, std::span<const std::filesystem::path> sourcePaths) {
+    if (isOutdated(filePath, sourcePaths))
+        return std::nullopt;
+
+    std::ifstream file(filePath, std::ios::binary);
+    GeometryFileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != GEOMETRY_FILE_MAGIC || header.version != GEOMETRY_FILE_VERSION) {
+        LOG("Geometry file " << filePath << " is invalid");
+        return std::nullopt;
+    }
+
+    return GeometryFile{
+        .materialCount = header.materialCount,
+        .contentHash = header.contentHash,
+        .vertexCount = header.counts[Vertices],
+        .triangleCount = header.counts[Triangles],
+    };
+}
+
+// Checks that every index stays in range, so a corrupt file can't make traversal or shading read outside the arrays
+static bool isValidGeometry(const MeshGeometry::PagedArrays& arrays, std::span<const BVH::Node> nodes, u32 materialCount) {
+    size_t vertexCount = arrays.vertices.size();
+    auto isValidAttribute = [&](size_t count) { return count == 0 || count == vertexCount; };
+    if (!isValidAttribute(arrays.uvs.size()) || !isValidAttribute(arrays.normals.size()) || !isValidAttribute(arrays.tangents.size()))
+        return false;
+
+    for (const Triangle& triangle : arrays.triangles) {
+        if (triangle.materialId >= materialCount)
+            return false;
+
+        for (u32 vertexId : triangle.vertexIds) {
+            if (vertexId >= vertexCount)
+                return false;
+        }
+    }
+
+    // Children come after their parent, so the depths are known when a node is checked
+    std::vector<u32> depths(nodes.size(), 0);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const BVH::Node& node = nodes[i];
+        if (node.triangleCount != 0) {
+            if ((u64)node.triangleIndex + node.triangleCount > arrays.triangles.size())
+                return false;
+            continue;
+        }
+
+        if (node.childIndex <= i || (u64)node.childIndex + 1 >= nodes.size() || depths[i] >= BVH_MAX_DEPTH)
+            return false;
+        depths[node.childIndex] = depths[node.childIndex + 1] = depths[i] + 1;
+    }
+    return true;
+}
+
+std::optional<GeometryFile> readGeometry(const std::filesystem::path& filePath, std::span<const std::filesystem::path> sourcePaths, PageCache* pageCache) {
+    if (isOutdated(filePath, sourcePaths))
+        return std::nullopt;
+
+    LOG("Loading geometry " << filePath << (pageCache ? " out of core" : ""));
+
+    // Empty files can't be mapped
+    std::error_code sizeError;
+    if (std::filesystem::file_size(filePath, sizeError) == 0 || sizeError) {
+        LOG("Geometry file " << filePath << " is invalid");
+        return std::nullopt;
+    }
+
+    Ref<PageCache::PagedFile> pagedFile;
+    MappedFile mappedFile;
+    try {
+        if (pageCache)
+            pagedFile = pageCache->open(filePath);
+        else
+            mappedFile = MappedFile(filePath);
+    }
+    catch (const std::exception& e) {
+        LOG("Failed to map geometry file " << filePath << ": " << e.what());
+        return std::nullopt;
+    }
+    const MappedFile& file = pagedFile ? pagedFile->m_file : mappedFile;
+
+    GeometryFileHeader header;
+    if (file.size() < sizeof(header)) {
+        LOG("Geometry file " << filePath << " is invalid");
+        return std::nullopt;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    GeometryFile geometryFile = {
+        .geometry = makeRef<MeshGeometry>(),
+        .materialCount = header.materialCount,
+        .contentHash = header.contentHash,
+        .vertexCount = header.counts[Vertices],
+        .triangleCount = header.counts[Triangles],
+    };
+    auto& geometry = *geometryFile.geometry;
+    geometry.materialCount = header.materialCount;
+
+    // The elements have the layout they had in memory
+    bool isValid = header.magic == GEOMETRY_FILE_MAGIC && header.version == GEOMETRY_FILE_VERSION;
+    auto view = [&]<typename T>(std::span<const T>& span, GeometryArray array) {
+        isValid &= header.offsets[array] <= file.size() && header.counts[array] <= (file.size() - header.offsets[array]) / sizeof(T);
+        if (isValid)
+            span = std::span(reinterpret_cast<const T*>(file.data() + header.offsets[array]), header.counts[array]);
+    };
+
+    auto& paged = geometry.paged;
+    std::span<const BVH::Node> nodes;
+    view(paged.vertices, Vertices);
+    view(paged.uvs, UVs);
+    view(paged.normals, Normals);
+    view(paged.tangents, Tangents);
+    view(paged.triangles, Triangles);
+    view(nodes, BVHNodes);
+
+    if (!isValid || nodes.empty() || !isValidGeometry(paged, nodes, header.materialCount)) {
+        LOG("Geometry file " << filePath << " is invalid");
+        return std::nullopt;
+    }
+
+    if (pagedFile) {
+        // The validation read the triangles and nodes past the page cache, drop them until they are touched
+        file.discard(0, file.size());
+        geometry.pagedFile = pagedFile;
+        geometry.bvh.setPaged(nodes, paged.triangles, paged.vertices, pagedFile);
+        pagedFile->pin(header.offsets[BVHNodes], std::min(nodes.size_bytes(), RESIDENT_BVH_SIZE));
+        return geometryFile;
+    }
+
+    // In core geometry copies the arrays, the file is unmapped afterwards
+    geometry.vertices.assign(paged.vertices.begin(), paged.vertices.end());
+    geometry.uvs.assign(paged.uvs.begin(), paged.uvs.end());
+    geometry.normals.assign(paged.normals.begin(), paged.normals.end());
+    geometry.tangents.assign(paged.tangents.begin(), paged.tangents.end());
+    geometry.triangles.assign(paged.triangles.begin(), paged.triangles.end());
+    paged = {};
+
+    geometry.bvh.setNodes(std::vector<BVH::Node>(nodes.begin(), nodes.end()));
+    return geometryFile;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Mesh.h"
+
+/*
+ * @brief Geometry read from a binary geometry file.
+ */
+struct GeometryFile {
+    Ref<MeshGeometry> geometry;
+    u32 materialCount = 0;  // Materials referenced by the triangles, including the default one
+    u64 contentHash = 0;    // Hash of the vertex attributes, triangles and BVH nodes
+    size_t vertexCount = 0;
+    size_t triangleCount = 0;
+};
+
+/*
+ * @return Hash of the vertex attributes, triangles and BVH nodes of a geometry in the full vertex format, the content hash of its geometry file.
+ */
+u64 geometryContentHash(const MeshGeometry& geometry);
+
+/*
+ * @brief Saves the geometry and its built BVH in the binary geometry format, loaded by readGeometry without parsing.
+ * @param materialCount Materials referenced by the triangles, including the default one.
+ * @return Content hash of the saved geometry.
+ */
+u64 writeGeometry(const std::filesystem::path& filePath, const MeshGeometry& geometry, u32 materialCount);
+
+/*
+ * @brief Reads only the header of a binary geometry file, to check it before its arrays are read.
+ * @param sourcePaths The files the geometry was converted from, like an OBJ and its material libraries. The geometry file is outdated if any of them is newer.
+ * @return The file without the geometry, nothing if the file is missing, outdated or invalid.
+ */
+std::optional<GeometryFile> readGeometryHeader(const std::filesystem::path& filePath, std::span<const std::filesystem::path> sourcePaths);
+
+/*
+ * @brief Maps a binary geometry file and copies its arrays into a new geometry, the BVH comes already built.
+ * @param sourcePaths The files the geometry was converted from, the geometry file is outdated if any of them is newer.
+ * @param pageCache Keeps the geometry out of core if not null, its arrays are read from the file and paged in on demand under the cache's budget.
+ *                  Only the top of the BVH is pinned resident.
+ * @return Nothing if the file is missing, outdated or invalid.
+ */
+std::optional<GeometryFile> readGeometry(const std::filesystem::path& filePath, std::span<const std::filesystem::path> sourcePaths, PageCache* pageCache = nullptr);
@@ -0,0 +1,97 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+MappedFile::MappedFile(const std::filesystem::path& filePath) {
+    HANDLE file = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER fileSize;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize)) {
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        LOG("Failed to open " << filePath);
+        throw std::runtime_error("Failed to map file");
+    }
+    m_fileHandle = (u64)file;
+    m_size = (size_t)fileSize.QuadPart;
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!data) {
+        if (mapping)
+            CloseHandle(mapping);
+        close();
+        LOG("Failed to map " << filePath);
+        throw std::runtime_error("Failed to map file");
+    }
+    m_mappingHandle = (u64)mapping;
+    m_data = static_cast<const u8*>(data);
+}
+
+void MappedFile::discard(size_t offset, size_t size) const {
+    // Unlocking pages that aren't locked removes them from the working set
+    VirtualUnlock(const_cast<u8*>(m_data + offset), std::min(size, m_size - offset));
+}
+
+void MappedFile::close() {
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mappingHandle != INVALID_HANDLE)
+        CloseHandle((HANDLE)m_mappingHandle);
+    if (m_fileHandle != INVALID_HANDLE)
+        CloseHandle((HANDLE)m_fileHandle);
+
+    m_data = nullptr;
+    m_size = 0;
+    m_fileHandle = INVALID_HANDLE;
+    m_mappingHandle = INVALID_HANDLE;
+}
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::filesystem::path& filePath) {
+    i32 file = ::open(filePath.c_str(), O_RDONLY);
+    struct stat fileStat;
+    if (file < 0 || fstat(file, &fileStat) != 0) {
+        if (file >= 0)
+            ::close(file);
+        LOG("Failed to open " << filePath);
+        throw std::runtime_error("Failed to map file");
+    }
+    m_fileHandle = (u64)file;
+    m_size = (size_t)fileStat.st_size;
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, file, 0);
+    if (data == MAP_FAILED) {
+        close();
+        LOG("Failed to map " << filePath);
+        throw std::runtime_error("Failed to map file");
+    }
+    m_data = static_cast<const u8*>(data);
+}
+
+void MappedFile::discard(size_t offset, size_t size) const {
+    // Clean pages of a shared file mapping are read from the file again on the next access
+    madvise(const_cast<u8*>(m_data + offset), std::min(size, m_size - offset), MADV_DONTNEED);
+}
+
+void MappedFile::close() {
+    if (m_data)
+        munmap(const_cast<u8*>(m_data), m_size);
+    if (m_fileHandle != INVALID_HANDLE)
+        ::close((i32)m_fileHandle);
+
+    m_data = nullptr;
+    m_size = 0;
+    m_fileHandle = INVALID_HANDLE;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+ * @brief Read-only memory mapping of a whole file.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    /*
+     * @brief Maps the file, throws if it can't be opened.
+     */
+    explicit MappedFile(const std::filesystem::path& filePath);
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)),
+          m_size(std::exchange(other.m_size, 0)),
+          m_fileHandle(std::exchange(other.m_fileHandle, INVALID_HANDLE)),
+          m_mappingHandle(std::exchange(other.m_mappingHandle, INVALID_HANDLE)) {}
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        close();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_fileHandle = std::exchange(other.m_fileHandle, INVALID_HANDLE);
+        m_mappingHandle = std::exchange(other.m_mappingHandle, INVALID_HANDLE);
+        return *this;
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    /*
+     * @brief Drops the pages of a range from memory, the next access reads them from the file again.
+     * @param offset Offset of the range, aligned to the page size.
+     * @param size Size of the range.
+     */
+    void discard(size_t offset, size_t size) const;
+
+    void close();
+
+    inline const u8* data() const { return m_data; }
+
+    inline size_t size() const { return m_size; }
+
+private:
+    static constexpr u64 INVALID_HANDLE = ~0ULL;
+
+    const u8* m_data = nullptr;
+    size_t m_size = 0;
+    u64 m_fileHandle = INVALID_HANDLE;
+    u64 m_mappingHandle = INVALID_HANDLE;  // Only used on Windows
+};
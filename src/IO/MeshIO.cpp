@@ -1,48 +1,89 @@
 #include "MeshIO.h"
 
+#include <cstring>
 #include <fstream>
+#include <sstream>
+#include <unordered_set>
 
+#include "GeometryIO.h"
+#include "GeometryRegistry.h"
 #include "Material.h"
-#include "TextureIO.h"
+#include "OBJParser.h"
+#include "TextureRegistry.h"
+#include "ThreadPool.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
-Model loadOBJ(const std::filesystem::path& filePath) {
-    LOG("Loading mesh " << filePath);
-
-    tinyobj::ObjReaderConfig reader_config;
-    reader_config.triangulate = true;
+const std::filesystem::path GEOMETRY_CACHE_FOLDER = "cache/geometry";
 
-    tinyobj::ObjReader reader;
+using TexturePrefetches = std::vector<std::future<Ref<void>>>;
 
-    if (!reader.ParseFromFile(filePath.string(), reader_config)) {
-        if (!reader.Error().empty())
-            LOG("tinyobjloader: " << reader.Error());
+template <typename T, typename Storage>
+static void prefetchTexture(TexturePrefetches& prefetches, const std::filesystem::path& filePath, TextureRegistry& textureRegistry, ThreadPool& pool) {
+    prefetches.push_back(pool.submit([filePath, &textureRegistry]() -> Ref<void> {
+        return textureRegistry.load<T, Storage>(filePath, true);
+    }));
+}
 
-        throw std::runtime_error("Failed to load mesh");
+/*
+ * @brief Reads the materials of the OBJ's material libraries without parsing the geometry.
+ * @param materialIds Receives the ids of the materials by name.
+ * @param libraryPaths Receives the paths of the libraries read.
+ */
+static std::vector<tinyobj::material_t> readMaterialLibraries(const std::filesystem::path& filePath, std::map<std::string, i32>& materialIds, std::vector<std::filesystem::path>& libraryPaths) {
+    std::vector<tinyobj::material_t> materials;
+
+    // Material libraries are referenced before the geometry, the first library of a statement that exists is read
+    std::ifstream file(filePath);
+    std::string line;
+    while (std::getline(file, line) && !line.starts_with("v ") && !line.starts_with("f ")) {
+        if (!line.starts_with("mtllib "))
+            continue;
+
+        std::istringstream libraryNames(line.substr(7));
+        std::string libraryName;
+        while (libraryNames >> libraryName) {
+            auto libraryPath = filePath.parent_path() / libraryName;
+            std::ifstream libraryFile(libraryPath);
+            if (!libraryFile)
+                continue;
+
+            std::string warning, error;
+            tinyobj::LoadMtl(&materialIds, &materials, &libraryFile, &warning, &error);
+            libraryPaths.push_back(libraryPath);
+            break;
+        }
     }
 
-    if (!reader.Warning().empty())
-        LOG("tinyobjloader: " << reader.Warning());
-
-    auto& loadedAttributes = reader.GetAttrib();
-    auto& loadedShapes = reader.GetShapes();
-    auto& loadedMaterials = reader.GetMaterials();
-
-    static_assert(sizeof(vec3) == 3 * sizeof(float));
-    static_assert(sizeof(vec2) == 2 * sizeof(float));
-    const vec3* loadedVertices = reinterpret_cast<const vec3*>(loadedAttributes.vertices.data());
-    const vec3* loadedNormals = reinterpret_cast<const vec3*>(loadedAttributes.normals.data());
-    const vec2* loadedUVs = reinterpret_cast<const vec2*>(loadedAttributes.texcoords.data());
+    return materials;
+}
 
-    bool hasNormals = !loadedAttributes.normals.empty();
-    bool hasUVs = !loadedAttributes.texcoords.empty();
-    bool calculateTangents = hasNormals && hasUVs;
+/*
+ * @brief Starts loading the textures of the materials on the pool.
+ *
+ * The materials pick the textures up from the registry later, the prefetches keep them alive meanwhile.
+ */
+static TexturePrefetches prefetchTextures(const std::vector<tinyobj::material_t>& materials, const std::filesystem::path& folder, TextureRegistry& textureRegistry, ThreadPool& pool) {
+    TexturePrefetches prefetches;
+    for (const auto& material : materials) {
+        if (!material.diffuse_texname.empty())
+            prefetchTexture<vec3, u8vec3>(prefetches, folder / material.diffuse_texname, textureRegistry, pool);
+        if (!material.emissive_texname.empty())
+            prefetchTexture<vec3, HalfTexel<3>>(prefetches, folder / material.emissive_texname, textureRegistry, pool);
+        if (!material.normal_texname.empty())
+            prefetchTexture<vec3, u8vec3>(prefetches, folder / material.normal_texname, textureRegistry, pool);
+        else if (!material.bump_texname.empty())
+            prefetchTexture<vec3, u8vec3>(prefetches, folder / material.bump_texname, textureRegistry, pool);
+        if (!material.alpha_texname.empty())
+            prefetchTexture<f32, u8>(prefetches, folder / material.alpha_texname, textureRegistry, pool);
+    }
 
-    Mesh modelMesh;
+    return prefetches;
+}
 
-    // Load materials
+static std::vector<Ref<Material>> createMaterials(const std::vector<tinyobj::material_t>& loadedMaterials, const std::filesystem::path& folder, TextureRegistry& textureRegistry) {
+    std::vector<Ref<Material>> materials;
     for (const auto& loadedMaterial : loadedMaterials) {
         auto material = makeRef<Material>();
         *material = {
@@ -53,124 +94,139 @@ Model loadOBJ(const std::filesystem::path& filePath) {
         };
 
         // TODO support texture options
-        // TODO share textures
         if (!loadedMaterial.diffuse_texname.empty())
-            material->albedoTexture = makeRef<Texture<vec3>>(loadTexture<vec3>(filePath.parent_path() / loadedMaterial.diffuse_texname, true));
+            material->albedoTexture = textureRegistry.load<vec3, u8vec3>(folder / loadedMaterial.diffuse_texname, true);
 
         if (!loadedMaterial.emissive_texname.empty())
-            material->emissionTexture = makeRef<Texture<vec3>>(loadTexture<vec3>(filePath.parent_path() / loadedMaterial.emissive_texname, true));
+            material->emissionTexture = textureRegistry.load<vec3, HalfTexel<3>>(folder / loadedMaterial.emissive_texname, true);
 
         if (!loadedMaterial.normal_texname.empty())
-            material->normalTexture = makeRef<Texture<vec3>>(loadTexture<vec3>(filePath.parent_path() / loadedMaterial.normal_texname, true));
+            material->normalTexture = textureRegistry.load<vec3, u8vec3>(folder / loadedMaterial.normal_texname, true);
         else if (!loadedMaterial.bump_texname.empty())  // TODO check if bump contains 3 channels
-            material->normalTexture = makeRef<Texture<vec3>>(loadTexture<vec3>(filePath.parent_path() / loadedMaterial.bump_texname, true));
+            material->normalTexture = textureRegistry.load<vec3, u8vec3>(folder / loadedMaterial.bump_texname, true);
 
         if (!loadedMaterial.alpha_texname.empty()) {
-            material->alphaTexture = makeRef<Texture<f32>>(loadTexture<f32>(filePath.parent_path() / loadedMaterial.alpha_texname, true));
+            material->alphaTexture = textureRegistry.load<f32, u8>(folder / loadedMaterial.alpha_texname, true);
             material->backfaceCulling = false;
         }
 
-        modelMesh.materials.push_back(material);
+        materials.push_back(material);
     }
 
-    // Load attributes and construct the triangle index buffer
-    modelMesh.geometry = makeRef<MeshGeometry>();
+    return materials;
+}
 
-    u32 vertexCount = loadedAttributes.vertices.size() / 3;
-    std::vector<std::vector<u32>> vertexIndices(vertexCount);
+// Attributes of a vertex, corners with equal attributes are welded into one vertex
+struct VertexKey {
+    vec3 position;
+    vec2 uv;
+    vec3 normal;
+
+    // Compares the bits like the hash does, so -0 and 0 stay apart and NaNs still find their own vertex
+    bool operator==(const VertexKey& other) const { return std::memcmp(this, &other, sizeof(VertexKey)) == 0; }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        static_assert(sizeof(VertexKey) == 8 * sizeof(f32));
+        const u32* words = reinterpret_cast<const u32*>(&key);
+
+        u64 hash = 0;
+        for (u32 i = 0; i < 8; i++)
+            hash = (hash ^ words[i]) * 0x9e3779b97f4a7c15;
+        return (size_t)(hash ^ (hash >> 32));
+    }
+};
+
+/*
+ * @brief Builds the vertex and triangle buffers with tangents from the parsed OBJ.
+ *
+ * Corners with the same position, uv and normal are welded into one vertex.
+ * @param materialCount Triangles without a material get this id, the default material is added after the loaded ones.
+ */
+static Ref<MeshGeometry> createGeometry(const OBJData& data, u32 materialCount) {
+    bool hasNormals = !data.normals.empty();
+    bool hasUVs = !data.uvs.empty();
+    bool calculateTangents = hasNormals && hasUVs;
 
-    std::vector<vec3> bitangents;  // Temporary storage for bitangents, used to calculate handedness of the tangent basis
+    // Load attributes and construct the triangle index buffer
+    auto geometry = makeRef<MeshGeometry>();
+    geometry->materialCount = materialCount;
 
-    bool hasNoMaterialTriangles = false;
+    size_t cornerCount = data.triangles.size() * 3;
+    geometry->triangles.reserve(data.triangles.size());
 
-    for (size_t shapeId = 0; shapeId < loadedShapes.size(); shapeId++) {
-        auto& mesh = loadedShapes[shapeId].mesh;
-        for (size_t triangleId = 0; triangleId < mesh.num_face_vertices.size(); triangleId++) {
-            auto& triangle = modelMesh.geometry->triangles.emplace_back();
+    std::unordered_map<VertexKey, u32, VertexKeyHash> vertexIndices;
+    vertexIndices.reserve(cornerCount);
 
-            // Load material
-            i32 materialId = mesh.material_ids[triangleId];
-            if (materialId < 0) {
-                // No material assigned to this triangle, use default material added at the end
-                hasNoMaterialTriangles = true;
-                materialId = modelMesh.materials.size();
-            }
-            triangle.materialId = materialId;
-
-            // Load triangle loadedVertices
-            assert(mesh.num_face_vertices[triangleId] == 3);
-            for (size_t vertexId = 0; vertexId < 3; vertexId++) {
-                tinyobj::index_t idx = mesh.indices[3 * triangleId + vertexId];
-
-                // Find or create vertex
-                u32 vertexIndex = u32(-1);
-                const vec3& vertexPosition = loadedVertices[idx.vertex_index];
-                const vec2& vertexUV = hasUVs && idx.texcoord_index >= 0 ? loadedUVs[idx.texcoord_index] : vec2(0);
-                const vec3& vertexNormal = hasNormals && idx.normal_index >= 0 ? loadedNormals[idx.normal_index] : vec3(0);
-
-                for (u32 index : vertexIndices[idx.vertex_index]) {
-                    bool hasSamePosition = true;  // modelMesh.geometry->vertices[index] == vertexPosition;  // This is already satisfied by using the same index
-                    bool hasSameUV = !hasUVs || modelMesh.geometry->uvs[index] == vertexUV;
-                    bool hasSameNormal = !hasNormals || modelMesh.geometry->normals[index] == vertexNormal;
-
-                    if (false && hasSamePosition && hasSameUV && hasSameNormal) {
-                        vertexIndex = index;
-                        break;
-                    }
-                }
+    std::vector<vec3> bitangents;  // Temporary storage for bitangents, used to calculate handedness of the tangent basis
 
-                if (vertexIndex == u32(-1)) {
-                    // Equal vertex was not found, create a new one
-
-                    modelMesh.geometry->vertices.push_back(vertexPosition);
-                    if (hasUVs)
-                        modelMesh.geometry->uvs.push_back(vertexUV);
-                    if (hasNormals)
-                        modelMesh.geometry->normals.push_back(vertexNormal);
-                    if (calculateTangents) {
-                        modelMesh.geometry->tangents.push_back(vec4(0));
-                        bitangents.push_back(vec3(0));
-                    }
-
-                    vertexIndex = modelMesh.geometry->vertices.size() - 1;
-                    vertexIndices[idx.vertex_index].push_back(vertexIndex);
-                }
+    for (size_t triangleId = 0; triangleId < data.triangles.size(); triangleId++) {
+        auto& triangle = geometry->triangles.emplace_back();
 
-                triangle.vertexIds[vertexId] = vertexIndex;
+        // Load material
+        i32 materialId = data.triangleMaterials[triangleId];
+        if (materialId < 0) {
+            // No material assigned to this triangle, use default material added at the end
+            geometry->materialCount = materialCount + 1;
+            materialId = materialCount;
+        }
+        triangle.materialId = materialId;
+
+        // Load triangle vertices
+        for (size_t vertexId = 0; vertexId < 3; vertexId++) {
+            const OBJCorner& corner = data.triangles[triangleId][vertexId];
+
+            // Find or create vertex
+            VertexKey key = {
+                .position = data.positions[corner.position],
+                .uv = hasUVs && corner.uv >= 0 ? data.uvs[corner.uv] : vec2(0),
+                .normal = hasNormals && corner.normal >= 0 ? data.normals[corner.normal] : vec3(0),
+            };
+
+            auto [vertex, isNew] = vertexIndices.try_emplace(key, (u32)geometry->vertices.size());
+            if (isNew) {
+                geometry->vertices.push_back(key.position);
+                if (hasUVs)
+                    geometry->uvs.push_back(key.uv);
+                if (hasNormals)
+                    geometry->normals.push_back(key.normal);
+                if (calculateTangents) {
+                    geometry->tangents.push_back(vec4(0));
+                    bitangents.push_back(vec3(0));
+                }
             }
 
-            // Calculate tangent and bitangent
-            if (calculateTangents) {
-                vec3 edge1 = modelMesh.geometry->vertices[triangle.vertexIds[1]] - modelMesh.geometry->vertices[triangle.vertexIds[0]];
-                vec3 edge2 = modelMesh.geometry->vertices[triangle.vertexIds[2]] - modelMesh.geometry->vertices[triangle.vertexIds[0]];
-                vec2 deltaUV1 = modelMesh.geometry->uvs[triangle.vertexIds[1]] - modelMesh.geometry->uvs[triangle.vertexIds[0]];
-                vec2 deltaUV2 = modelMesh.geometry->uvs[triangle.vertexIds[2]] - modelMesh.geometry->uvs[triangle.vertexIds[0]];
+            triangle.vertexIds[vertexId] = vertex->second;
+        }
 
-                f32 determinantInv = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+        // Calculate tangent and bitangent
+        if (calculateTangents) {
+            vec3 edge1 = geometry->vertices[triangle.vertexIds[1]] - geometry->vertices[triangle.vertexIds[0]];
+            vec3 edge2 = geometry->vertices[triangle.vertexIds[2]] - geometry->vertices[triangle.vertexIds[0]];
+            vec2 deltaUV1 = geometry->uvs[triangle.vertexIds[1]] - geometry->uvs[triangle.vertexIds[0]];
+            vec2 deltaUV2 = geometry->uvs[triangle.vertexIds[2]] - geometry->uvs[triangle.vertexIds[0]];
 
-                vec3 tangent = glm::normalize(determinantInv * (deltaUV2.y * edge1 - deltaUV1.y * edge2));
-                vec3 bitangent = glm::normalize(determinantInv * (-deltaUV2.x * edge1 + deltaUV1.x * edge2));
+            f32 determinantInv = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
 
-                for (size_t i = 0; i < 3; i++) {
-                    modelMesh.geometry->tangents[triangle.vertexIds[i]] += vec4(tangent, 0);
-                    bitangents[triangle.vertexIds[i]] += bitangent;
-                }
+            vec3 tangent = glm::normalize(determinantInv * (deltaUV2.y * edge1 - deltaUV1.y * edge2));
+            vec3 bitangent = glm::normalize(determinantInv * (-deltaUV2.x * edge1 + deltaUV1.x * edge2));
+
+            // Triangles with degenerate uvs would spread NaNs to every triangle sharing their welded vertices
+            bool isDegenerate = !std::isfinite(glm::compAdd(tangent) + glm::compAdd(bitangent));
+            for (size_t i = 0; i < 3 && !isDegenerate; i++) {
+                geometry->tangents[triangle.vertexIds[i]] += vec4(tangent, 0);
+                bitangents[triangle.vertexIds[i]] += bitangent;
             }
         }
     }
 
-    if (hasNoMaterialTriangles) {
-        // Add default material for triangles without one
-        LOG("Mesh has triangles without material, adding default material");
-        modelMesh.materials.push_back(makeRef<Material>());
-    }
-
     // Calculate per vertex tangents
     if (calculateTangents) {
-        for (size_t i = 0; i < modelMesh.geometry->vertices.size(); i++) {
-            vec3 tangent = vec3(modelMesh.geometry->tangents[i]);
+        for (size_t i = 0; i < geometry->vertices.size(); i++) {
+            vec3 tangent = vec3(geometry->tangents[i]);
             const vec3& bitangent = bitangents[i];
-            const vec3& normal = modelMesh.geometry->normals[i];
+            const vec3& normal = geometry->normals[i];
 
             // Gram-Schmidt orthogonalization
             tangent = glm::normalize(tangent - glm::dot(tangent, normal) * normal);
@@ -179,18 +235,211 @@ Model loadOBJ(const std::filesystem::path& filePath) {
             f32 handedness = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
             // bitangent = glm::normalize(handedness * glm::cross(normal, tangent));
 
-            modelMesh.geometry->tangents[i] = vec4(tangent, handedness);
+            geometry->tangents[i] = vec4(tangent, handedness);
+        }
+    }
+
+    size_t vertexSize = sizeof(vec3) + (hasUVs ? sizeof(vec2) : 0) + (hasNormals ? sizeof(vec3) : 0) + (calculateTangents ? sizeof(vec4) : 0);
+    LOG(std::format("Welded {} corners into {} vertices, {:.1f} MB of vertex attributes saved",
+                    cornerCount, geometry->vertices.size(), (f64)(cornerCount - geometry->vertices.size()) * vertexSize / (1024 * 1024)));
+
+    geometry->vertices.shrink_to_fit();
+    geometry->uvs.shrink_to_fit();
+    geometry->normals.shrink_to_fit();
+    geometry->tangents.shrink_to_fit();
+    geometry->triangles.shrink_to_fit();
+
+    return geometry;
+}
+
+/*
+ * @brief Reorders the vertices to the order the triangles first use them in.
+ *
+ * Runs after the BVH build, which sorts the triangles by leaf, so the vertices of a leaf end up next to each other.
+ */
+static void reorderVertices(MeshGeometry& geometry) {
+    constexpr u32 UNUSED = u32(-1);
+
+    // Average distance between the vertices of consecutive corners, a proxy of the cache lines touched per triangle
+    auto averageVertexJump = [&]() {
+        u64 jumpSum = 0;
+        u32 previousId = 0;
+        for (const auto& triangle : geometry.triangles) {
+            for (u32 vertexId : triangle.vertexIds) {
+                jumpSum += vertexId > previousId ? vertexId - previousId : previousId - vertexId;
+                previousId = vertexId;
+            }
+        }
+        return geometry.triangles.empty() ? 0.0 : (f64)jumpSum / (geometry.triangles.size() * 3);
+    };
+    f64 jumpBefore = averageVertexJump();
+
+    std::vector<u32> newIds(geometry.vertices.size(), UNUSED);
+    std::vector<u32> oldIds;
+    oldIds.reserve(geometry.vertices.size());
+    for (auto& triangle : geometry.triangles) {
+        for (u32& vertexId : triangle.vertexIds) {
+            if (newIds[vertexId] == UNUSED) {
+                newIds[vertexId] = (u32)oldIds.size();
+                oldIds.push_back(vertexId);
+            }
+            vertexId = newIds[vertexId];
         }
     }
 
-    modelMesh.geometry->vertices.shrink_to_fit();
-    modelMesh.geometry->uvs.shrink_to_fit();
-    modelMesh.geometry->normals.shrink_to_fit();
-    modelMesh.geometry->tangents.shrink_to_fit();
-    modelMesh.geometry->triangles.shrink_to_fit();
+    // Unreferenced vertices are dropped
+    auto reorder = [&](auto& attributes) {
+        if (attributes.empty())
+            return;
+
+        std::remove_reference_t<decltype(attributes)> reordered(oldIds.size());
+        for (size_t i = 0; i < oldIds.size(); i++)
+            reordered[i] = attributes[oldIds[i]];
+        attributes.swap(reordered);
+    };
+    reorder(geometry.vertices);
+    reorder(geometry.uvs);
+    reorder(geometry.normals);
+    reorder(geometry.tangents);
+
+    LOG(std::format("Reordered vertices, average vertex jump per corner {:.1f} -> {:.1f}", jumpBefore, averageVertexJump()));
+}
+
+static std::filesystem::path geometryCachePath(const std::filesystem::path& filePath) {
+    auto key = std::filesystem::weakly_canonical(filePath).string();
+    return GEOMETRY_CACHE_FOLDER / std::format("{}-{:016x}.lwgeo", filePath.stem().string(), (u64)std::hash<std::string>()(key));
+}
+
+Model loadOBJ(const std::filesystem::path& filePath, const OBJLoadOptions& options) {
+    LOG("Loading mesh " << filePath);
+
+    TextureRegistry modelTextureRegistry;
+    TextureRegistry* textureRegistry = options.textureRegistry ? options.textureRegistry : &modelTextureRegistry;
+    ThreadPool* pool = options.pool;
+
+    auto folder = filePath.parent_path();
+    std::map<std::string, i32> materialIds;
+    std::vector<std::filesystem::path> sourcePaths = {filePath};  // The material libraries assign the material ids too
+    auto libraryMaterials = readMaterialLibraries(filePath, materialIds, sourcePaths);
+
+    // Textures are decoded while the geometry is loaded
+    TexturePrefetches texturePrefetches;
+    if (pool)
+        texturePrefetches = prefetchTextures(libraryMaterials, folder, *textureRegistry, *pool);
+
+    // Loads of the same source share one geometry, concurrent loads wait for the first one instead of converting the OBJ again
+    GeometryRegistry* geometryRegistry = options.geometryRegistry;
+    bool isPaged = options.geometryPageCache != nullptr;
+    Ref<GeometryRegistry::Reservation> reservation;
+    Ref<MeshGeometry> geometry;
+    if (geometryRegistry)
+        geometry = geometryRegistry->acquire(GeometryRegistry::sourceKey(filePath, (u32)libraryMaterials.size(), options.vertexFormat, isPaged), reservation);
+
+    // OBJs loaded before have their geometry and BVH in the geometry cache, only the materials are read from the source
+    auto cachePath = geometryCachePath(filePath);
+    std::optional<GeometryFile> geometryHeader;
+    if (!geometry)
+        geometryHeader = readGeometryHeader(cachePath, sourcePaths);
+    if (geometryHeader && (geometryHeader->materialCount < libraryMaterials.size() || geometryHeader->materialCount > libraryMaterials.size() + 1)) {
+        LOG("Geometry file " << cachePath << " doesn't match the materials, converting again");
+        geometryHeader.reset();
+    }
+
+    // Geometry of the same content loaded from another source is shared, the file is only read by the first load
+    if (geometryHeader) {
+        auto contentKey = GeometryRegistry::contentKey(geometryHeader->contentHash, options.vertexFormat, isPaged);
+        if (geometryRegistry)
+            geometry = geometryRegistry->find(contentKey, geometryHeader->vertexCount, geometryHeader->triangleCount);
+
+        if (!geometry) {
+            if (auto geometryFile = readGeometry(cachePath, sourcePaths, options.geometryPageCache)) {
+                geometry = geometryFile->geometry;
+                if (options.vertexFormat == VertexFormat::Quantized)
+                    geometry->quantize();
+                if (geometryRegistry)
+                    geometryRegistry->add(contentKey, geometry);
+            }
+        }
+
+        if (geometry && reservation)
+            reservation->finish(geometry, geometry->dataSize());
+    }
+
+    bool isConverted = !geometry;
+    OBJData objData;
+    if (isConverted)
+        objData = parseOBJ(filePath, materialIds);
+
+    Mesh modelMesh;
+    modelMesh.materials = createMaterials(libraryMaterials, folder, *textureRegistry);
+
+    // Prefetches of textures the materials didn't use could still reference the registry
+    for (auto& prefetch : texturePrefetches)
+        prefetch.wait();
+
+    // Shared textures are counted once
+    size_t textureMemory = 0;
+    std::unordered_set<const void*> countedTextures;
+    auto countTexture = [&](const auto& texture) {
+        if (texture && countedTextures.insert(texture.get()).second)
+            textureMemory += texture->memoryUsage();
+    };
+    for (const auto& material : modelMesh.materials) {
+        countTexture(material->albedoTexture);
+        countTexture(material->emissionTexture);
+        countTexture(material->normalTexture);
+        countTexture(material->alphaTexture);
+    }
+    if (textureMemory != 0)
+        LOG(std::format("Texture memory: {:.1f} MB", (f64)textureMemory / (1024 * 1024)));
+
+    if (isConverted) {
+        geometry = createGeometry(objData, (u32)modelMesh.materials.size());
+        objData = {};
+    }
+    modelMesh.geometry = geometry;
+
+    if (geometry->materialCount > modelMesh.materials.size()) {
+        // Add default material for triangles without one
+        LOG("Mesh has triangles without material, adding default material");
+        modelMesh.materials.push_back(makeRef<Material>());
+    }
 
     Model model(std::move(modelMesh));
     model.m_name = filePath.stem().string();
 
+    if (isConverted) {
+        // The BVH is built once and saved with the reordered geometry, later loads skip parsing, building and reordering.
+        // Loads waiting for the reservation get the geometry once it is final, in core even if they asked for out of core geometry.
+        auto finishGeometry = [cachePath, options, reservation, sharedGeometry = geometry](MeshGeometry& geometry) {
+            reorderVertices(geometry);
+
+            // The content is hashed in memory if the cache can't be written, so the geometry is still shared
+            u64 contentHash;
+            try {
+                contentHash = writeGeometry(cachePath, geometry, geometry.materialCount);
+            }
+            catch (const std::exception& exception) {
+                LOG("Geometry cache not saved: " << exception.what());
+                contentHash = geometryContentHash(geometry);
+            }
+
+            if (options.vertexFormat == VertexFormat::Quantized)
+                geometry.quantize();
+
+            if (options.geometryRegistry)
+                options.geometryRegistry->add(GeometryRegistry::contentKey(contentHash, options.vertexFormat, false), sharedGeometry);
+            if (reservation)
+                reservation->finish(sharedGeometry, sharedGeometry->dataSize());
+        };
+
+        if (pool)
+            model.buildBVHAsync(*pool, finishGeometry);
+        else {
+            geometry->bvh.build();
+            finishGeometry(*geometry);
+        }
+    }
+
     return model;
 }
@@ -2,4 +2,23 @@
 
 #include "Hittables/Model.h"
 
-Model loadOBJ(const std::filesystem::path& filePath);
+class GeometryRegistry;
+class TextureRegistry;
+class ThreadPool;
+
+struct OBJLoadOptions {
+    TextureRegistry* textureRegistry = nullptr;  // Registry to share the textures through, they are only shared inside the model if null
+    // Pool to decode the textures on while the OBJ is parsed and to build the BVH on afterwards,
+    // everything is loaded on the calling thread if null
+    ThreadPool* pool = nullptr;
+    VertexFormat vertexFormat = VertexFormat::Full;  // Storage of the vertex attributes, the geometry cache always keeps the f32 attributes
+    // Keeps the geometry out of core if not null, paged in from the geometry cache under the page cache's budget.
+    // The first load still converts the OBJ in core.
+    PageCache* geometryPageCache = nullptr;
+    GeometryRegistry* geometryRegistry = nullptr;  // Registry to share the geometry and BVH through, loads of the same OBJ or of the same content share them
+};
+
+/*
+ * @brief Loads a Wavefront OBJ with its materials, the materials are never shared with other models.
+ */
+Model loadOBJ(const std::filesystem::path& filePath, const OBJLoadOptions& options = {});
@@ -0,0 +1,319 @@
+#include "OBJParser.h"
+
+#include <charconv>
+#include <cstring>
+
+#include "MappedFile.h"
+
+constexpr size_t OBJ_CHUNK_SIZE = 4 << 20;
+
+struct OBJChunk {
+    const char* begin;
+    const char* end;
+
+    // Counted by the first pass
+    size_t positionCount = 0;
+    size_t uvCount = 0;
+    size_t normalCount = 0;
+    size_t triangleCount = 0;
+    std::optional<std::string> lastMaterial;  // Name of the last usemtl
+
+    // Prefix sums of the previous chunks
+    size_t positionBase = 0;
+    size_t uvBase = 0;
+    size_t normalBase = 0;
+    size_t triangleBase = 0;
+    i32 initialMaterial = -1;
+
+    std::string error;  // Set if the second pass failed, exceptions can't leave the parallel loop
+};
+
+enum class OBJStatement {
+    Position,
+    UV,
+    Normal,
+    Face,
+    UseMaterial,
+    Other,
+};
+
+static inline void skipSpaces(const char*& p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+}
+
+// Reads the statement keyword and skips the spaces after it
+static inline OBJStatement readStatement(const char*& p, const char* end) {
+    skipSpaces(p, end);
+    const char* keywordBegin = p;
+    while (p < end && *p != ' ' && *p != '\t')
+        p++;
+    std::string_view keyword(keywordBegin, p - keywordBegin);
+    skipSpaces(p, end);
+
+    if (keyword == "v")
+        return OBJStatement::Position;
+    if (keyword == "vt")
+        return OBJStatement::UV;
+    if (keyword == "vn")
+        return OBJStatement::Normal;
+    if (keyword == "f")
+        return OBJStatement::Face;
+    if (keyword == "usemtl")
+        return OBJStatement::UseMaterial;
+    return OBJStatement::Other;
+}
+
+// Calls f with the begin and end of every line, without the line break
+template <typename F>
+static void forEachLine(const char* begin, const char* end, F&& f) {
+    while (begin < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        if (!lineEnd)
+            lineEnd = end;
+
+        const char* contentEnd = lineEnd;
+        if (contentEnd > begin && contentEnd[-1] == '\r')
+            contentEnd--;
+
+        f(begin, contentEnd);
+        begin = lineEnd + 1;
+    }
+}
+
+// Missing components are left as they are
+template <glm::length_t L>
+static inline void readFloats(const char* p, const char* end, glm::vec<L, f32>& value) {
+    for (glm::length_t i = 0; i < L; i++) {
+        skipSpaces(p, end);
+        auto [next, error] = std::from_chars(p, end, value[i]);
+        if (error != std::errc())
+            return;
+        p = next;
+    }
+}
+
+// Reads the next whitespace separated corner of a face, both passes split faces with it so their triangle counts agree
+static inline bool readCorner(const char*& p, const char* end, std::string_view& corner) {
+    skipSpaces(p, end);
+    if (p == end)
+        return false;
+
+    const char* cornerBegin = p;
+    while (p < end && *p != ' ' && *p != '\t')
+        p++;
+    corner = std::string_view(cornerBegin, p - cornerBegin);
+    return true;
+}
+
+static inline u32 countCorners(const char* p, const char* end) {
+    u32 count = 0;
+    for (std::string_view corner; readCorner(p, end, corner);)
+        count++;
+    return count;
+}
+
+static std::string readName(const char* p, const char* end) {
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t'))
+        end--;
+    return std::string(p, end);
+}
+
+// Counts the elements of a chunk, so the second pass knows where to write them
+static void countChunk(OBJChunk& chunk) {
+    forEachLine(chunk.begin, chunk.end, [&](const char* p, const char* end) {
+        switch (readStatement(p, end)) {
+            case OBJStatement::Position:
+                chunk.positionCount++;
+                break;
+            case OBJStatement::UV:
+                chunk.uvCount++;
+                break;
+            case OBJStatement::Normal:
+                chunk.normalCount++;
+                break;
+            case OBJStatement::Face:
+                chunk.triangleCount += std::max(countCorners(p, end), 2U) - 2;
+                break;
+            case OBJStatement::UseMaterial:
+                chunk.lastMaterial = readName(p, end);
+                break;
+            default:
+                break;
+        }
+    });
+}
+
+/*
+ * @brief Resolves an index of a face corner.
+ * @param count Number of the elements defined before the face.
+ * @return 0 based index, -1 if out of range.
+ */
+static inline i32 resolveIndex(i32 index, size_t count) {
+    i64 resolved = index > 0 ? (i64)index - 1 : (i64)count + index;
+    return index != 0 && resolved >= 0 && resolved < (i64)count ? (i32)resolved : -1;
+}
+
+/*
+ * @brief Parses a face corner, v, v/vt, v//vn or v/vt/vn.
+ * @param counts Number of the positions, uvs and normals defined before the face.
+ * @return Error message, empty on success.
+ */
+static std::string parseCorner(std::string_view text, const std::array<size_t, 3>& counts, OBJCorner& corner) {
+    std::array<i32*, 3> indices = {&corner.position, &corner.uv, &corner.normal};
+    const char* p = text.data();
+    const char* end = p + text.size();
+    for (u32 i = 0; i < 3; i++) {
+        const char* componentEnd = static_cast<const char*>(std::memchr(p, '/', end - p));
+        if (!componentEnd)
+            componentEnd = end;
+
+        if (p < componentEnd) {
+            i32 index = 0;
+            auto [next, error] = std::from_chars(p, componentEnd, index);
+            if (error != std::errc() || next != componentEnd)
+                return std::format("Invalid face corner {}", text);
+
+            *indices[i] = resolveIndex(index, counts[i]);
+            if (*indices[i] < 0)
+                return std::format("Face index {} out of range", index);
+        }
+
+        if (componentEnd == end)
+            break;
+        p = componentEnd + 1;
+        if (i == 2)
+            return std::format("Invalid face corner {}", text);
+    }
+
+    if (corner.position < 0)
+        return "Face corner without a position";
+    return {};
+}
+
+static void parseChunk(OBJChunk& chunk, OBJData& data, const std::map<std::string, i32>& materialIds) {
+    size_t positionIndex = chunk.positionBase;
+    size_t uvIndex = chunk.uvBase;
+    size_t normalIndex = chunk.normalBase;
+    size_t triangleIndex = chunk.triangleBase;
+    i32 material = chunk.initialMaterial;
+
+    std::vector<OBJCorner> faceCorners;
+    forEachLine(chunk.begin, chunk.end, [&](const char* p, const char* end) {
+        if (!chunk.error.empty())
+            return;
+
+        switch (readStatement(p, end)) {
+            case OBJStatement::Position:
+                readFloats(p, end, data.positions[positionIndex++]);
+                break;
+            case OBJStatement::UV:
+                readFloats(p, end, data.uvs[uvIndex++]);
+                break;
+            case OBJStatement::Normal:
+                readFloats(p, end, data.normals[normalIndex++]);
+                break;
+            case OBJStatement::Face: {
+                faceCorners.clear();
+                for (std::string_view text; readCorner(p, end, text);) {
+                    OBJCorner corner;
+                    chunk.error = parseCorner(text, {positionIndex, uvIndex, normalIndex}, corner);
+                    if (!chunk.error.empty())
+                        return;
+                    faceCorners.push_back(corner);
+                }
+
+                // The first pass counted the corners the same way, this only guards the writes
+                size_t faceTriangles = std::max(faceCorners.size(), (size_t)2) - 2;
+                if (triangleIndex + faceTriangles > chunk.triangleBase + chunk.triangleCount) {
+                    chunk.error = "Face triangles exceed the counted triangles";
+                    return;
+                }
+
+                for (size_t i = 2; i < faceCorners.size(); i++) {
+                    data.triangles[triangleIndex] = {faceCorners[0], faceCorners[i - 1], faceCorners[i]};
+                    data.triangleMaterials[triangleIndex] = material;
+                    triangleIndex++;
+                }
+                break;
+            }
+            case OBJStatement::UseMaterial: {
+                auto it = materialIds.find(readName(p, end));
+                material = it != materialIds.end() ? it->second : -1;
+                break;
+            }
+            default:
+                break;
+        }
+    });
+}
+
+OBJData parseOBJ(const std::filesystem::path& filePath, const std::map<std::string, i32>& materialIds) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    MappedFile file(filePath);
+    const char* fileBegin = reinterpret_cast<const char*>(file.data());
+    const char* fileEnd = fileBegin + file.size();
+
+    // Chunks end after a line break
+    std::vector<OBJChunk> chunks;
+    for (const char* chunkBegin = fileBegin; chunkBegin < fileEnd;) {
+        const char* chunkEnd = chunkBegin + std::min(OBJ_CHUNK_SIZE, (size_t)(fileEnd - chunkBegin));
+        const char* lineBreak = static_cast<const char*>(std::memchr(chunkEnd, '\n', fileEnd - chunkEnd));
+        chunkEnd = lineBreak ? lineBreak + 1 : fileEnd;
+
+        chunks.push_back({.begin = chunkBegin, .end = chunkEnd});
+        chunkBegin = chunkEnd;
+    }
+
+    NODEBUG_ONLY(_Pragma("omp parallel for"))
+    for (i32 i = 0; i < (i32)chunks.size(); i++)
+        countChunk(chunks[i]);
+
+    OBJChunk total = {};
+    i32 material = -1;
+    for (auto& chunk : chunks) {
+        chunk.positionBase = total.positionCount;
+        chunk.uvBase = total.uvCount;
+        chunk.normalBase = total.normalCount;
+        chunk.triangleBase = total.triangleCount;
+        chunk.initialMaterial = material;
+
+        total.positionCount += chunk.positionCount;
+        total.uvCount += chunk.uvCount;
+        total.normalCount += chunk.normalCount;
+        total.triangleCount += chunk.triangleCount;
+        if (chunk.lastMaterial) {
+            auto it = materialIds.find(*chunk.lastMaterial);
+            material = it != materialIds.end() ? it->second : -1;
+        }
+    }
+
+    if (total.positionCount > (size_t)std::numeric_limits<i32>::max()) {
+        LOG("Mesh " << filePath << " has too many vertices");
+        throw std::runtime_error("Failed to load mesh");
+    }
+
+    OBJData data;
+    data.positions.resize(total.positionCount);
+    data.uvs.resize(total.uvCount, vec2(0));
+    data.normals.resize(total.normalCount, vec3(0));
+    data.triangles.resize(total.triangleCount);
+    data.triangleMaterials.resize(total.triangleCount);
+
+    NODEBUG_ONLY(_Pragma("omp parallel for"))
+    for (i32 i = 0; i < (i32)chunks.size(); i++)
+        parseChunk(chunks[i], data, materialIds);
+
+    for (const auto& chunk : chunks) {
+        if (!chunk.error.empty()) {
+            LOG("Failed to parse " << filePath << ": " << chunk.error);
+            throw std::runtime_error("Failed to load mesh");
+        }
+    }
+
+    auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start);
+    LOG(std::format("Parsed {} vertices and {} triangles in {} chunks in {:.2f}s", data.positions.size(), data.triangles.size(), chunks.size(), time.count() / 1000.0));
+
+    return data;
+}
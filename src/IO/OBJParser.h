@@ -0,0 +1,31 @@
+#pragma once
+
+/*
+ * @brief Attribute indices of a triangle corner, 0 based, -1 if the corner has no such attribute.
+ */
+struct OBJCorner {
+    i32 position = -1;
+    i32 uv = -1;
+    i32 normal = -1;
+};
+
+/*
+ * @brief Geometry of an OBJ with the polygons triangulated as fans.
+ */
+struct OBJData {
+    std::vector<vec3> positions;
+    std::vector<vec2> uvs;
+    std::vector<vec3> normals;
+    std::vector<std::array<OBJCorner, 3>> triangles;
+    std::vector<i32> triangleMaterials;  // -1 for triangles without a material
+};
+
+/*
+ * @brief Parses the geometry of an OBJ, the memory mapped file is split into chunks parsed in parallel.
+ *
+ * Supports positions, uvs, normals, faces with absolute or relative indices and usemtl,
+ * other statements are skipped. Materials are read separately, see readMaterialLibraries in MeshIO.cpp.
+ *
+ * @param materialIds Ids of the materials by name, usemtl of other names assigns no material.
+ */
+OBJData parseOBJ(const std::filesystem::path& filePath, const std::map<std::string, i32>& materialIds);
@@ -0,0 +1,157 @@
+#include "Socket.h"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+using NativeSocket = SOCKET;
+
+constexpr i32 SHUTDOWN_BOTH = SD_BOTH;
+constexpr i32 SEND_FLAGS = 0;
+
+static void closeNativeSocket(NativeSocket socket) {
+    closesocket(socket);
+}
+
+#else
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using NativeSocket = i32;
+
+constexpr NativeSocket INVALID_SOCKET = -1;
+constexpr i32 SHUTDOWN_BOTH = SHUT_RDWR;
+constexpr i32 SEND_FLAGS = MSG_NOSIGNAL;  // Report closed connections as errors instead of SIGPIPE
+
+static void closeNativeSocket(NativeSocket socket) {
+    ::close(socket);
+}
+
+#endif
+
+static void initializeSockets() {
+#ifdef _WIN32
+    static bool initialized = [] {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+            LOG("Winsock initialization failed");
+            throw std::runtime_error("Winsock initialization failed");
+        }
+        return true;
+    }();
+#endif
+}
+
+Socket Socket::listen(u16 port) {
+    initializeSockets();
+
+    NativeSocket handle = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (handle == INVALID_SOCKET) {
+        LOG("Creating socket failed");
+        throw std::runtime_error("Creating socket failed");
+    }
+
+    Socket socket((u64)handle);
+
+    i32 reuse = 1;
+    setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);  // Never exposed outside of the machine
+
+    if (::bind(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(handle, SOMAXCONN) != 0) {
+        LOG(std::format("Listening on port {} failed", port));
+        throw std::runtime_error("Listening on socket failed");
+    }
+
+    return socket;
+}
+
+Socket Socket::connect(u16 port) {
+    initializeSockets();
+
+    NativeSocket handle = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (handle == INVALID_SOCKET)
+        return Socket();
+
+    Socket socket((u64)handle);
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (::connect(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+        return Socket();
+
+    return socket;
+}
+
+Socket Socket::accept() const {
+    NativeSocket handle = ::accept((NativeSocket)m_handle, nullptr, nullptr);
+    if (handle == INVALID_SOCKET)
+        return Socket();
+
+    return Socket((u64)handle);
+}
+
+bool Socket::readLine(std::string& line, size_t maxLength) {
+    while (true) {
+        size_t newline = m_readBuffer.find('\n');
+        if (newline != std::string::npos) {
+            line = m_readBuffer.substr(0, newline);
+            m_readBuffer.erase(0, newline + 1);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            return true;
+        }
+
+        if (m_readBuffer.size() > maxLength)
+            return false;
+
+        char buffer[1024];
+        auto received = ::recv((NativeSocket)m_handle, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+            return false;
+
+        m_readBuffer.append(buffer, received);
+    }
+}
+
+bool Socket::send(const void* data, size_t size) const {
+    const char* bytes = reinterpret_cast<const char*>(data);
+    while (size > 0) {
+        i32 chunk = (i32)std::min(size, (size_t)INT32_MAX);
+        auto sent = ::send((NativeSocket)m_handle, bytes, chunk, SEND_FLAGS);
+        if (sent <= 0)
+            return false;
+
+        bytes += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+
+void Socket::shutdown() const {
+    if (isValid())
+        ::shutdown((NativeSocket)m_handle, SHUTDOWN_BOTH);
+}
+
+void Socket::close() {
+    if (!isValid())
+        return;
+
+    closeNativeSocket((NativeSocket)m_handle);
+    m_handle = INVALID_HANDLE;
+}
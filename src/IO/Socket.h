@@ -0,0 +1,74 @@
+#pragma once
+
+/*
+ * @brief Minimal blocking TCP socket, only listens on localhost.
+ */
+class Socket {
+public:
+    Socket() = default;
+
+    Socket(const Socket&) = delete;
+
+    Socket(Socket&& other) noexcept : m_handle(std::exchange(other.m_handle, INVALID_HANDLE)) {}
+
+    Socket& operator=(const Socket&) = delete;
+
+    Socket& operator=(Socket&& other) noexcept {
+        close();
+        m_handle = std::exchange(other.m_handle, INVALID_HANDLE);
+        return *this;
+    }
+
+    ~Socket() {
+        close();
+    }
+
+    /*
+     * @brief Creates a socket listening on 127.0.0.1.
+     * @param port The port to listen on.
+     */
+    static Socket listen(u16 port);
+
+    /*
+     * @brief Connects to a socket listening on 127.0.0.1.
+     * @param port The port to connect to.
+     * @return The connected socket, an invalid one if the connection failed.
+     */
+    static Socket connect(u16 port);
+
+    /*
+     * @brief Waits for a client to connect.
+     * @return The connected socket, an invalid one if the listening socket was shut down.
+     */
+    Socket accept() const;
+
+    /*
+     * @brief Reads until a newline, the newline is not included.
+     * @param maxLength Longest accepted line, a longer one fails the read so a client can't grow the buffer without limit.
+     * @return False if the connection was closed or the line was too long.
+     */
+    bool readLine(std::string& line, size_t maxLength = 4096);
+
+    /*
+     * @brief Sends the whole buffer.
+     * @return False if the connection was closed.
+     */
+    bool send(const void* data, size_t size) const;
+
+    /*
+     * @brief Stops all pending and future operations, blocked calls return.
+     */
+    void shutdown() const;
+
+    void close();
+
+    inline bool isValid() const { return m_handle != INVALID_HANDLE; }
+
+private:
+    static constexpr u64 INVALID_HANDLE = ~0ULL;
+
+    u64 m_handle = INVALID_HANDLE;
+    std::string m_readBuffer;
+
+    explicit Socket(u64 handle) : m_handle(handle) {}
+};
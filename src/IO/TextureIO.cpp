@@ -12,21 +12,38 @@
 
 #include "TextureIO.h"
 
-template <typename T>
-Texture<T> loadTexture(const std::filesystem::path& filePath, bool flipVertically) {
-    if (filePath.extension() == ".exr")
-        return loadEXR<T>(filePath, flipVertically);
+template <typename T, typename Storage>
+Texture<T, Storage> loadTexture(const std::filesystem::path& filePath, bool flipVertically, bool generateMips, TextureLayout layout) {
+    Texture<T, Storage> texture;
+    if (filePath.extension() == ".exr") {
+        auto loaded = loadEXR<T>(filePath, flipVertically);
+        if constexpr (std::is_same_v<T, Storage>)
+            texture = std::move(loaded);
+        else
+            texture = loaded.template encoded<Storage>();
+    }
     else
-        return loadTextureSTB<T>(filePath, flipVertically);
-}
+        texture = loadTextureSTB<T, Storage>(filePath, flipVertically);
 
-template Texture<f32> loadTexture(const std::filesystem::path& filePath, bool flipVertically);
-template Texture<vec2> loadTexture(const std::filesystem::path& filePath, bool flipVertically);
-template Texture<vec3> loadTexture(const std::filesystem::path& filePath, bool flipVertically);
-template Texture<vec4> loadTexture(const std::filesystem::path& filePath, bool flipVertically);
+    texture.setLayout(layout);
+    if (generateMips)
+        texture.generateMips();
 
-template <typename T>
-Texture<T> loadTextureSTB(const std::filesystem::path& filePath, bool flipVertically) {
+    return texture;
+}
+
+template Texture<f32> loadTexture(const std::filesystem::path& filePath, bool flipVertically, bool generateMips, TextureLayout layout);
+template Texture<vec2> loadTexture(const std::filesystem::path& filePath, bool flipVertically, bool generateMips, TextureLayout layout);
+template Texture<vec3> loadTexture(const std::filesystem::path& filePath, bool flipVertically, bool generateMips, TextureLayout layout);
+template Texture<vec4> loadTexture(const std::filesystem::path& filePath, bool flipVertically, bool generateMips, TextureLayout layout);
+template Texture<f32, u8> loadTexture(const std::filesystem::path& filePath, bool flipVertically, bool generateMips, TextureLayout layout);
+template Texture<vec3, u8vec3> loadTexture(const std::filesystem::path& filePath, bool flipVertically, bool generateMips, TextureLayout layout);
+template Texture<vec4, glm::u8vec4> loadTexture(const std::filesystem::path& filePath, bool flipVertically, bool generateMips, TextureLayout layout);
+template Texture<vec3, glm::u16vec3> loadTexture(const std::filesystem::path& filePath, bool flipVertically, bool generateMips, TextureLayout layout);
+template Texture<vec3, HalfTexel<3>> loadTexture(const std::filesystem::path& filePath, bool flipVertically, bool generateMips, TextureLayout layout);
+
+template <typename T, typename Storage>
+Texture<T, Storage> loadTextureSTB(const std::filesystem::path& filePath, bool flipVertically) {
     LOG("Loading texture " << filePath);
 
     u32 channelsToLoad = 3;
@@ -41,27 +58,49 @@ Texture<T> loadTextureSTB(const std::filesystem::path& filePath, bool flipVertic
     else
         assert(false);
 
-    if (flipVertically)
-        stbi_set_flip_vertically_on_load(true);
-    else
-        stbi_set_flip_vertically_on_load(false);
+    // Textures are loaded on several threads, the global flip setting would race
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
 
     i32 channels;
     ivec2 size;
-    T* data = nullptr;
+    Storage* data = nullptr;
 
     const auto filePathStr = filePath.string();
-    if (stbi_is_hdr(filePathStr.c_str()))
-        data = reinterpret_cast<T*>(stbi_loadf(filePathStr.c_str(), &size.x, &size.y, &channels, channelsToLoad));
+    if (stbi_is_hdr(filePathStr.c_str())) {
+        f32* dataF32 = stbi_loadf(filePathStr.c_str(), &size.x, &size.y, &channels, channelsToLoad);
+
+        if (dataF32) {
+            data = new Storage[size.x * size.y];
+            for (size_t i = 0; i < size.x * size.y; i++)
+                data[i] = encodeTexel<Storage>(reinterpret_cast<const T*>(dataF32)[i]);
+            stbi_image_free(dataF32);
+        }
+    }
+    else if constexpr (std::is_same_v<typename TexelComponent<Storage>::Type, u16>) {
+        // 16 bit storage loads 16 bit files at full precision, 8 bit files are widened by stb
+        static_assert(texelComponentCount<Storage>() == texelComponentCount<T>(), "16 bit storage has to match the loaded channels");
+        u16* dataU16 = stbi_load_16(filePathStr.c_str(), &size.x, &size.y, &channels, channelsToLoad);
+
+        if (dataU16) {
+            data = new Storage[size.x * size.y];
+            std::memcpy(data, dataU16, size.x * size.y * sizeof(Storage));
+            stbi_image_free(dataU16);
+        }
+    }
     else {
-        // TODO add u8 texture support
-
         u8* dataU8 = stbi_load(filePathStr.c_str(), &size.x, &size.y, &channels, channelsToLoad);
 
         if (dataU8) {
-            data = new T[size.x * size.y];
-            for (size_t i = 0; i < size.x * size.y * channelsToLoad; i++)
-                reinterpret_cast<f32*>(data)[i] = static_cast<f32>(dataU8[i]) / 255.0f;
+            // 8 bit storage keeps the loaded texels as they are
+            using U8Texel = std::conditional_t<std::is_arithmetic_v<T>, u8, glm::vec<texelComponentCount<T>(), u8>>;
+            data = new Storage[size.x * size.y];
+            if constexpr (std::is_same_v<Storage, U8Texel>)
+                std::memcpy(data, dataU8, size.x * size.y * sizeof(Storage));
+            else {
+                for (size_t i = 0; i < size.x * size.y; i++)
+                    data[i] = encodeTexel<Storage>(decodeTexel<T>(reinterpret_cast<const U8Texel*>(dataU8)[i]));
+            }
+            stbi_image_free(dataU8);
         }
     }
 
@@ -70,7 +109,7 @@ Texture<T> loadTextureSTB(const std::filesystem::path& filePath, bool flipVertic
         throw std::runtime_error("Failed to load texture");
     }
 
-    return Texture<T>(size, std::move(data));
+    return Texture<T, Storage>(size, std::move(data));
 }
 
 template <typename T>
@@ -164,9 +203,14 @@ Texture<T> loadEXR(const std::filesystem::path& filePath, bool flipVertically) {
     return Texture<T>(size, std::move(data));
 }
 
-void writeBMP(const std::filesystem::path& filePath, const Texture<u8vec3> texture, bool flipVertically) {
+void writeBMP(const std::filesystem::path& filePath, TextureView<u8vec3> texture, bool flipVertically) {
     LOG("Saving texture " << filePath);
 
+    if (texture.layout() != TextureLayout::Linear) {
+        LOG("Saving tiled textures as BMP is not supported");
+        throw std::runtime_error("Saving tiled textures as BMP is not supported");
+    }
+
     if (flipVertically)
         stbi_flip_vertically_on_write(true);
     else
@@ -181,7 +225,7 @@ void writeBMP(const std::filesystem::path& filePath, const Texture<u8vec3> textu
 }
 
 template <typename T>
-void writeEXR(const std::filesystem::path& filePath, const Texture<T> texture, bool flipVertically) {
+void writeEXR(const std::filesystem::path& filePath, TextureView<T> texture, bool flipVertically) {
     LOG("Saving texture " << filePath);
 
     u32 channelsToSave = 1;
@@ -206,14 +250,13 @@ void writeEXR(const std::filesystem::path& filePath, const Texture<T> texture, b
     for (u32 i = 0; i < channelsToSave; i++)
         images.push_back(new f32[texture.size().x * texture.size().y]);
 
-    const f32* dataf32 = reinterpret_cast<const f32*>(texture.data());
     auto idx = uvec2(0);
     for (idx.y = 0; idx.y < texture.size().y; idx.y++) {
         for (idx.x = 0; idx.x < texture.size().x; idx.x++) {
-            auto i = idx.y * texture.size().x + idx.x;
+            const f32* texelf32 = reinterpret_cast<const f32*>(&texture[idx]);
             auto flippedI = (flipVertically ? texture.size().y - 1 - idx.y : idx.y) * texture.size().x + idx.x;
             for (u32 channel = 0; channel < channelsToSave; channel++)
-                images[channel][flippedI] = dataf32[i * channelsToSave + channel];
+                images[channel][flippedI] = texelf32[channel];
         }
     }
 
@@ -259,7 +302,7 @@ void writeEXR(const std::filesystem::path& filePath, const Texture<T> texture, b
     }
 }
 
-template void writeEXR(const std::filesystem::path& filePath, const Texture<f32> texture, bool flipVertically);
-template void writeEXR(const std::filesystem::path& filePath, const Texture<vec2> texture, bool flipVertically);
-template void writeEXR(const std::filesystem::path& filePath, const Texture<vec3> texture, bool flipVertically);
-template void writeEXR(const std::filesystem::path& filePath, const Texture<vec4> texture, bool flipVertically);
+template void writeEXR(const std::filesystem::path& filePath, TextureView<f32> texture, bool flipVertically);
+template void writeEXR(const std::filesystem::path& filePath, TextureView<vec2> texture, bool flipVertically);
+template void writeEXR(const std::filesystem::path& filePath, TextureView<vec3> texture, bool flipVertically);
+template void writeEXR(const std::filesystem::path& filePath, TextureView<vec4> texture, bool flipVertically);
@@ -2,16 +2,30 @@
 
 #include "Texture.h"
 
-template <typename T>
-Texture<T> loadTexture(const std::filesystem::path& filePath, bool flipVertically = false);
+/*
+ * @brief Loads an EXR or any image supported by stb_image.
+ * @tparam Storage The texel storage format, 8 bit images are stored without conversion in u8 formats.
+ * @param generateMips Generates the MIP pyramid for trilinear sampling.
+ * @param layout Memory layout of the texels, tiled textures are faster to sample at random uvs.
+ */
+template <typename T, typename Storage = T>
+Texture<T, Storage> loadTexture(const std::filesystem::path& filePath, bool flipVertically = false, bool generateMips = true, TextureLayout layout = TextureLayout::Linear);
 
-template <typename T>
-Texture<T> loadTextureSTB(const std::filesystem::path& filePath, bool flipVertically = false);
+template <typename T, typename Storage = T>
+Texture<T, Storage> loadTextureSTB(const std::filesystem::path& filePath, bool flipVertically = false);
 
 template <typename T>
 Texture<T> loadEXR(const std::filesystem::path& filePath, bool flipVertically = false);
 
-void writeBMP(const std::filesystem::path& filePath, const Texture<u8vec3> texture, bool flipVertically = false);
+/*
+ * @brief Saves an 8 bit sRGB texture, the texels have to be in the linear layout.
+ */
+void writeBMP(const std::filesystem::path& filePath, TextureView<u8vec3> texture, bool flipVertically = false);
+
+template <typename T>
+void writeEXR(const std::filesystem::path& filePath, TextureView<T> texture, bool flipVertically = false);
 
 template <typename T>
-void writeEXR(const std::filesystem::path& filePath, const Texture<T> texture, bool flipVertically = false);
+inline void writeEXR(const std::filesystem::path& filePath, const Texture<T>& texture, bool flipVertically = false) {
+    writeEXR(filePath, texture.view(), flipVertically);
+}
@@ -0,0 +1,73 @@
+#include "InteractiveSession.h"
+
+InteractiveSession::InteractiveSession(const Renderer& renderer, Ref<World> world, Ref<Camera> camera)
+    : m_renderer(renderer), m_world(world), m_camera(camera) {
+    m_renderer.m_timeBudget = m_frameBudget;
+    m_renderer.m_minSamples = 1;
+    m_renderer.m_partitionIndex = 0;
+    m_renderer.m_partitionCount = 1;
+
+    m_world->frameBegin();  // Build the BVHs before the first frame
+}
+
+void InteractiveSession::renderFrame() {
+    auto frameStart = std::chrono::high_resolution_clock::now();
+
+    // Transform edits are applied here, the frameBegin of the renderer is a no-op afterwards
+    if (m_world->frameBegin()) {
+        m_stats.sceneUpdateTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - frameStart);
+        reset();
+    }
+
+    m_renderer.m_timeBudget = m_frameBudget;
+    m_renderer.m_samples = m_sampleCount + m_maxSamplesPerFrame;
+    m_renderer.m_progressiveLevels = m_resetLevels;  // Only used when starting from zero samples
+
+    m_accumulation = m_renderer.accumulateFrame(m_world, m_camera, std::move(m_accumulation), m_sampleCount);
+    m_sampleCount = m_renderer.stats().sampleCount;
+
+    auto frameEnd = std::chrono::high_resolution_clock::now();
+    m_stats.frameTime = std::chrono::duration_cast<std::chrono::microseconds>(frameEnd - frameStart);
+    m_stats.frameCount++;
+
+    if (m_editPending) {
+        m_stats.editLatency = std::chrono::duration_cast<std::chrono::microseconds>(frameEnd - m_editTime);
+        m_editPending = false;
+
+        LOG(std::format("Edit latency {:.2f}ms (scene update {:.2f}ms)", m_stats.editLatency.count() / 1000.0, m_stats.sceneUpdateTime.count() / 1000.0));
+        m_stats.sceneUpdateTime = std::chrono::microseconds(0);
+    }
+
+    if (m_frameCallback)
+        m_frameCallback(m_accumulation, m_sampleCount);
+}
+
+void InteractiveSession::editCamera(const std::function<void(Camera&)>& edit) {
+    edit(*m_camera);
+    reset();
+}
+
+void InteractiveSession::editMaterial(Material& material, const std::function<void(Material&)>& edit) {
+    // Materials are only read while shading, the geometry and its BVH stay valid
+    edit(material);
+    reset();
+}
+
+void InteractiveSession::editTransform(Transform& transform, const std::function<void(Transform&)>& edit) {
+    edit(transform);  // Invalidates the cached matrices
+    m_world->markDirty();
+
+    if (!m_editPending) {
+        m_editPending = true;
+        m_editTime = std::chrono::high_resolution_clock::now();
+    }
+}
+
+void InteractiveSession::reset() {
+    m_sampleCount = 0;
+
+    if (!m_editPending) {
+        m_editPending = true;
+        m_editTime = std::chrono::high_resolution_clock::now();
+    }
+}
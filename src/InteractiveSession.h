@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Renderer.h"
+
+/*
+ * @brief Progressive render loop for interactive use, every frame adds as many samples as fit into the frame budget.
+ *
+ * Edits go through the session so it knows what to reset. Camera and material edits only restart the accumulation,
+ * transform edits also update the instance matrices in the next frameBegin. BVHs are never rebuilt.
+ */
+class InteractiveSession {
+public:
+    struct Stats {
+        u32 frameCount = 0;
+        std::chrono::microseconds frameTime = std::chrono::microseconds(0);
+        std::chrono::microseconds sceneUpdateTime = std::chrono::microseconds(0);  // frameBegin of the last frame with changed geometry
+        std::chrono::microseconds editLatency = std::chrono::microseconds(0);      // From the last edit to the end of the first frame showing it
+    };
+
+    std::chrono::milliseconds m_frameBudget = std::chrono::milliseconds(33);
+    u32 m_maxSamplesPerFrame = 16;
+    u32 m_resetLevels = 3;  // Progressive levels of the first frame after a reset
+
+    std::function<void(const AccumulationBuffer&, u32)> m_frameCallback;  // Called after every frame with the accumulated sample count
+
+    InteractiveSession(const Renderer& renderer, Ref<World> world, Ref<Camera> camera);
+
+    void renderFrame();
+
+    /*
+     * @brief Changes the camera and restarts the accumulation.
+     */
+    void editCamera(const std::function<void(Camera&)>& edit);
+
+    /*
+     * @brief Changes a material and restarts the accumulation, the scene isn't updated.
+     */
+    void editMaterial(Material& material, const std::function<void(Material&)>& edit);
+
+    /*
+     * @brief Changes a transform of the scene, the next frame updates its matrices and restarts the accumulation.
+     */
+    void editTransform(Transform& transform, const std::function<void(Transform&)>& edit);
+
+    inline u32 sampleCount() const { return m_sampleCount; }
+
+    inline const Stats& stats() const { return m_stats; }
+
+private:
+    Renderer m_renderer;
+    Ref<World> m_world;
+    Ref<Camera> m_camera;
+
+    AccumulationBuffer m_accumulation;
+    u32 m_sampleCount = 0;
+
+    bool m_editPending = false;
+    std::chrono::high_resolution_clock::time_point m_editTime;
+
+    Stats m_stats;
+
+    void reset();
+};
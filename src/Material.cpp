@@ -1,8 +1,10 @@
 #include "Material.h"
 
+constexpr f32 DIFFUSE_CONE_SPREAD = 0.1f;  // Heuristic widening of the ray cone by a diffuse bounce
+
 SCATTER_FUNCTION(lambertianScatter) {
     // Alpha-clip
-    f32 alpha = material.alphaTexture ? material.alphaTexture->sampleInterpolated(hit.uv) : 1.0;
+    f32 alpha = material.alphaTexture ? material.alphaTexture->sampleTrilinear(hit.uv, hit.uvFootprint) : 1.0;
     if (alpha < 0.5f) {
         hit.hit = false;
         return {};
@@ -11,29 +13,30 @@ SCATTER_FUNCTION(lambertianScatter) {
     // Normal mapping
     if (material.normalTexture) {
         mat3 tbn = mat3(hit.tangent, hit.bitangent, hit.normal);
-        vec3 normalMapSample = material.normalTexture->sampleInterpolated(hit.uv) * 2.0f - 1.0f;
+        vec3 normalMapSample = material.normalTexture->sampleTrilinear(hit.uv, hit.uvFootprint) * 2.0f - 1.0f;
         hit.normal = glm::normalize(tbn * normalMapSample);
     }
 
     // Lambert
-    auto scatterDirection = hit.normal + randomUnitVec<3>();
+    auto scatterDirection = hit.normal + squareToUnitSphere(sampler.get2D());
 
     if (glm::any(glm::abs(scatterDirection) < vec3(1e-8f)))  // Near zero direction fix
         scatterDirection = hit.normal;
 
-    auto albedo = material.albedoTexture ? material.albedoTexture->sampleInterpolated(hit.uv) : material.albedo;
-    auto emission = material.emissionTexture ? material.emissionTexture->sampleInterpolated(hit.uv) : material.emission;
+    auto albedo = material.albedoTexture ? material.albedoTexture->sampleTrilinear(hit.uv, hit.uvFootprint) : material.albedo;
+    auto emission = material.emissionTexture ? material.emissionTexture->sampleTrilinear(hit.uv, hit.uvFootprint) : material.emission;
 
     return {
         .scatterDirection = glm::normalize(scatterDirection),
         .albedo = albedo,
         .emission = emission * material.emissionIntensity,
+        .coneSpread = DIFFUSE_CONE_SPREAD,
     };
 }
 
 SCATTER_FUNCTION(metallicScatter) {
     // Alpha-clip
-    f32 alpha = material.alphaTexture ? material.alphaTexture->sampleInterpolated(hit.uv) : 1.0;
+    f32 alpha = material.alphaTexture ? material.alphaTexture->sampleTrilinear(hit.uv, hit.uvFootprint) : 1.0;
     if (alpha < 0.5f) {
         hit.hit = false;
         return {};
@@ -42,22 +45,23 @@ SCATTER_FUNCTION(metallicScatter) {
     // Normal mapping
     if (material.normalTexture) {
         mat3 tbn = mat3(hit.tangent, hit.bitangent, hit.normal);
-        vec3 normalMapSample = material.normalTexture->sampleInterpolated(hit.uv) * 2.0f - 1.0f;
+        vec3 normalMapSample = material.normalTexture->sampleTrilinear(hit.uv, hit.uvFootprint) * 2.0f - 1.0f;
         hit.normal = glm::normalize(tbn * normalMapSample);
     }
 
     // Metallic
     auto reflected = reflect(ray.direction, hit.normal);
-    reflected += material.fuzziness * randomUnitVec<3>();
+    reflected += material.fuzziness * squareToUnitSphere(sampler.get2D());
 
-    auto albedo = material.albedoTexture ? material.albedoTexture->sampleInterpolated(hit.uv) : material.albedo;
-    auto emission = material.emissionTexture ? material.emissionTexture->sampleInterpolated(hit.uv) : material.emission;
+    auto albedo = material.albedoTexture ? material.albedoTexture->sampleTrilinear(hit.uv, hit.uvFootprint) : material.albedo;
+    auto emission = material.emissionTexture ? material.emissionTexture->sampleTrilinear(hit.uv, hit.uvFootprint) : material.emission;
 
     return {
         .didScatter = glm::dot(reflected, hit.normal) > 0,
         .scatterDirection = glm::normalize(reflected),
         .albedo = albedo,
         .emission = emission * material.emissionIntensity,
+        .coneSpread = material.fuzziness * DIFFUSE_CONE_SPREAD,
     };
 }
 
@@ -65,7 +69,7 @@ SCATTER_FUNCTION(dielectricScatter) {
     // Normal mapping
     if (material.normalTexture) {
         mat3 tbn = mat3(hit.tangent, hit.bitangent, hit.normal);
-        vec3 normalMapSample = material.normalTexture->sampleInterpolated(hit.uv) * 2.0f - 1.0f;
+        vec3 normalMapSample = material.normalTexture->sampleTrilinear(hit.uv, hit.uvFootprint) * 2.0f - 1.0f;
         hit.normal = glm::normalize(tbn * normalMapSample);
     }
 
@@ -80,7 +84,7 @@ SCATTER_FUNCTION(dielectricScatter) {
     vec3 scatterDirection;  // normalized
 
     bool totalInternalReflection = refractionRatio * sinTheta > 1.0f;
-    if (totalInternalReflection || reflectance(cosTheta, refractionRatio) > random<f32>())
+    if (totalInternalReflection || reflectance(cosTheta, refractionRatio) > sampler.get1D())
         scatterDirection = reflect(ray.direction, outwardNormal);
     else
         scatterDirection = ::refract(ray.direction, outwardNormal, refractionRatio);
@@ -99,7 +103,7 @@ SCATTER_FUNCTION(environmentScatter) {
     if (material.emissionTexture) {
         f32 u = atan2(ray.direction.z, ray.direction.x) / TWO_PI + 0.5f;
         f32 v = acos(ray.direction.y) / PI;
-        emission = material.emissionTexture->sampleInterpolated({u, v});
+        emission = material.emissionTexture->sampleTrilinear({u, v}, ray.coneSpread / PI);  // Angular footprint, v spans PI
     }
     else
         emission = material.emission;
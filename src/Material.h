@@ -2,6 +2,7 @@
 
 #include "Hittables/IHittable.h"
 #include "Ray.h"
+#include "Sampler.h"
 #include "Texture.h"
 
 struct ScatterOutput {
@@ -10,9 +11,10 @@ struct ScatterOutput {
     vec3 scatterDirection;
     vec3 albedo = DEBUG_COLOR;
     vec3 emission = vec3(0);
+    f32 coneSpread = 0;  // Spread angle added to the ray cone by the scattering lobe
 };
 
-#define SCATTER_FUNCTION(name) ScatterOutput name(const Material& material, const Ray& ray, HitRecord& hit)
+#define SCATTER_FUNCTION(name) ScatterOutput name(const Material& material, const Ray& ray, HitRecord& hit, Sampler& sampler)
 
 SCATTER_FUNCTION(lambertianScatter);
 
@@ -22,17 +24,22 @@ SCATTER_FUNCTION(dielectricScatter);
 
 SCATTER_FUNCTION(environmentScatter);
 
+// Storage formats of the material maps
+using ColorTexture = Texture<vec3, u8vec3>;           // 8 bit albedo and normal maps
+using EmissionTexture = Texture<vec3, HalfTexel<3>>;  // HDR emission and environment maps
+using AlphaTexture = Texture<f32, u8>;
+
 struct Material {
 public:
     std::string name = "Unnamed";
 
     vec3 albedo = vec3(0.8f);
-    Ref<Texture<vec3>> albedoTexture;
+    Ref<ColorTexture> albedoTexture;
     vec3 emission = vec3(0);
-    Ref<Texture<vec3>> emissionTexture;
+    Ref<EmissionTexture> emissionTexture;
     f32 emissionIntensity = 0;
-    Ref<Texture<vec3>> normalTexture;
-    Ref<Texture<f32>> alphaTexture;  // TODO u8
+    Ref<ColorTexture> normalTexture;
+    Ref<AlphaTexture> alphaTexture;
 
     f32 fuzziness = 0;
     f32 ir = 1;
@@ -4,22 +4,188 @@
 
 struct Material;
 
-struct Triangle {
-    std::array<u32, 3> vertexIds;
-    u32 materialId;
+enum class VertexFormat {
+    Full,       // f32 attributes
+    Quantized,  // 16 bit uvs and octahedral normals and tangents, positions stay f32 for the intersection
 };
 
+// Largest uv step of the 16 bit uvs, a texel of a 4096 texture, wider uv bounds keep the f32 uvs
+constexpr f32 MAX_QUANTIZED_UV_STEP = 1.0f / 4096;
+
+/*
+ * @brief Octahedral encoding of a unit vector into 2x16 bit unsigned normalized components.
+ */
+inline u32 packOctahedral(const vec3& v) {
+    f32 l1Norm = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    vec2 p = l1Norm > 0 ? vec2(v) / l1Norm : vec2(0);  // Degenerate vectors become +z
+    if (v.z < 0) {
+        vec2 signs(p.x >= 0 ? 1.0f : -1.0f, p.y >= 0 ? 1.0f : -1.0f);
+        p = (1.0f - glm::abs(vec2(p.y, p.x))) * signs;
+    }
+
+    uvec2 quantized = uvec2(glm::round(glm::clamp(p * 0.5f + 0.5f, 0.0f, 1.0f) * 65535.0f));
+    return quantized.x | quantized.y << 16;
+}
+
+/*
+ * @return The unit vector of an octahedral encoding.
+ */
+inline vec3 unpackOctahedral(u32 packed) {
+    vec2 p = vec2(packed & 0xffff, packed >> 16) * (2.0f / 65535.0f) - 1.0f;
+    vec3 v(p, 1.0f - std::abs(p.x) - std::abs(p.y));
+    if (v.z < 0) {
+        vec2 signs(v.x >= 0 ? 1.0f : -1.0f, v.y >= 0 ? 1.0f : -1.0f);
+        v = vec3((1.0f - glm::abs(vec2(v.y, v.x))) * signs, v.z);
+    }
+    return glm::normalize(v);
+}
+
 struct MeshGeometry {
     std::vector<vec3> vertices;
     std::vector<vec2> uvs;
     std::vector<vec3> normals;
     std::vector<vec4> tangents;  // xyz = tangent, w = handedness
 
+    // Replace the f32 attributes in VertexFormat::Quantized
+    std::vector<u32> packedUVs;       // 2x16 bit unsigned normalized in the uv bounds, empty if the f32 uvs are kept
+    std::vector<u32> packedNormals;   // Octahedral
+    std::vector<u32> packedTangents;  // Octahedral, the lowest bit of the second component is set for negative handedness
+    vec2 uvOrigin = vec2(0);
+    vec2 uvExtent = vec2(0);
+
     std::vector<Triangle> triangles;
 
+    // Out of core geometry reads its arrays from the paged geometry file instead, the vectors stay empty
+    struct PagedArrays {
+        std::span<const vec3> vertices;
+        std::span<const vec2> uvs;
+        std::span<const vec3> normals;
+        std::span<const vec4> tangents;
+        std::span<const Triangle> triangles;
+    };
+    Ref<PageCache::PagedFile> pagedFile;
+    PagedArrays paged;
+
     BVH bvh;
 
+    VertexFormat vertexFormat = VertexFormat::Full;
+    u32 materialCount = 0;  // Materials referenced by the triangles, including the default one
+
     MeshGeometry() : bvh(vertices, triangles) {}
+
+    inline bool isPaged() const { return pagedFile != nullptr; }
+
+    inline bool hasUVs() const { return !uvs.empty() || !packedUVs.empty() || !paged.uvs.empty(); }
+
+    inline bool hasNormals() const { return !normals.empty() || !packedNormals.empty() || !paged.normals.empty(); }
+
+    inline bool hasTangents() const { return !tangents.empty() || !packedTangents.empty() || !paged.tangents.empty(); }
+
+    inline size_t vertexCount() const { return isPaged() ? paged.vertices.size() : vertices.size(); }
+
+    inline size_t triangleCount() const { return isPaged() ? paged.triangles.size() : triangles.size(); }
+
+    inline const Triangle& triangle(u32 triangleId) const { return fetch(triangles, paged.triangles, triangleId); }
+
+    inline const vec3& vertex(u32 vertexId) const { return fetch(vertices, paged.vertices, vertexId); }
+
+    inline vec2 uv(u32 vertexId) const {
+        if (vertexFormat == VertexFormat::Full || packedUVs.empty())
+            return fetch(uvs, paged.uvs, vertexId);
+
+        u32 packed = packedUVs[vertexId];
+        return uvOrigin + vec2(packed & 0xffff, packed >> 16) * (uvExtent / 65535.0f);
+    }
+
+    inline vec3 normal(u32 vertexId) const {
+        return vertexFormat == VertexFormat::Full ? fetch(normals, paged.normals, vertexId) : unpackOctahedral(packedNormals[vertexId]);
+    }
+
+    inline vec4 tangent(u32 vertexId) const {
+        if (vertexFormat == VertexFormat::Full)
+            return fetch(tangents, paged.tangents, vertexId);
+
+        u32 packed = packedTangents[vertexId];
+        return vec4(unpackOctahedral(packed), packed & BIT(16) ? -1.0f : 1.0f);
+    }
+
+    /*
+     * @return Bytes of the vertex attributes, triangles and BVH nodes, including the mapped arrays of out of core geometry.
+     */
+    size_t dataSize() const {
+        auto bytes = [](const auto& array) { return array.size() * sizeof(array[0]); };
+        return bytes(vertices) + bytes(uvs) + bytes(normals) + bytes(tangents) + bytes(triangles) +
+               bytes(packedUVs) + bytes(packedNormals) + bytes(packedTangents) +
+               bytes(paged.vertices) + bytes(paged.uvs) + bytes(paged.normals) + bytes(paged.tangents) + bytes(paged.triangles) +
+               bvh.stats().nodeCount * sizeof(BVH::Node);
+    }
+
+    /*
+     * @brief Replaces the f32 uvs, normals and tangents by their quantized encodings.
+     *
+     * The uvs stay f32 if their bounds are too wide for a 16 bit step of at most MAX_QUANTIZED_UV_STEP.
+     */
+    void quantize() {
+        if (vertexFormat == VertexFormat::Quantized)
+            return;
+
+        if (isPaged()) {
+            LOG("Out of core geometry keeps the f32 attributes of its file");
+            return;
+        }
+
+        size_t fullSize = uvs.size() * sizeof(vec2) + normals.size() * sizeof(vec3) + tangents.size() * sizeof(vec4);
+
+        if (!uvs.empty()) {
+            vec2 uvMin = uvs[0], uvMax = uvs[0];
+            for (const auto& uv : uvs) {
+                uvMin = glm::min(uvMin, uv);
+                uvMax = glm::max(uvMax, uv);
+            }
+
+            // Tiled uvs spanning many repeats would lose whole texels
+            vec2 extent = uvMax - uvMin;
+            if (glm::all(glm::lessThanEqual(extent / 65535.0f, vec2(MAX_QUANTIZED_UV_STEP)))) {
+                uvOrigin = uvMin;
+                uvExtent = extent;
+
+                vec2 scale = glm::mix(vec2(0), 65535.0f / uvExtent, glm::greaterThan(uvExtent, vec2(0)));
+                packedUVs.resize(uvs.size());
+                for (size_t i = 0; i < uvs.size(); i++) {
+                    uvec2 quantized = uvec2(glm::round((uvs[i] - uvOrigin) * scale));
+                    packedUVs[i] = quantized.x | quantized.y << 16;
+                }
+                uvs = {};
+            }
+            else
+                LOG(std::format("UV bounds of {:.1f}x{:.1f} are too wide to quantize, keeping the f32 uvs", extent.x, extent.y));
+        }
+
+        packedNormals.resize(normals.size());
+        for (size_t i = 0; i < normals.size(); i++)
+            packedNormals[i] = packOctahedral(normals[i]);
+
+        packedTangents.resize(tangents.size());
+        for (size_t i = 0; i < tangents.size(); i++)
+            packedTangents[i] = (packOctahedral(vec3(tangents[i])) & ~BIT(16)) | (tangents[i].w < 0 ? BIT(16) : 0);
+
+        normals = {};
+        tangents = {};
+        vertexFormat = VertexFormat::Quantized;
+
+        size_t quantizedSize = uvs.size() * sizeof(vec2) + (packedUVs.size() + packedNormals.size() + packedTangents.size()) * sizeof(u32);
+        LOG(std::format("Quantized vertex attributes, {:.1f} MB -> {:.1f} MB", (f64)fullSize / (1024 * 1024), (f64)quantizedSize / (1024 * 1024)));
+    }
+
+private:
+    template <typename T>
+    inline const T& fetch(const std::vector<T>& array, std::span<const T> pagedArray, u32 index) const {
+        if (!pagedFile)
+            return array[index];
+
+        pagedFile->touch(&pagedArray[index]);
+        return pagedArray[index];
+    }
 };
 
 struct Mesh {
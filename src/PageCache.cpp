@@ -0,0 +1,105 @@
+#include "PageCache.h"
+
+PageCache::PagedFile::PagedFile(PageCache& cache, MappedFile&& file) : m_file(std::move(file)), m_cache(cache) {
+    size_t pageCount = (m_file.size() + PAGE_SIZE - 1) / PAGE_SIZE;
+    m_pageStates = std::make_unique<std::atomic<u8>[]>(pageCount);
+    for (size_t i = 0; i < pageCount; i++)
+        m_pageStates[i].store(Unmapped, std::memory_order_relaxed);
+}
+
+PageCache::PagedFile::~PagedFile() {
+    m_cache.release(*this);
+}
+
+void PageCache::PagedFile::pin(size_t offset, size_t size) {
+    if (size == 0 || offset >= m_file.size())
+        return;
+
+    size_t firstPage = offset / PAGE_SIZE;
+    size_t lastPage = (std::min(offset + size, m_file.size()) - 1) / PAGE_SIZE;
+
+    std::lock_guard lock(m_cache.m_mutex);
+    for (size_t page = firstPage; page <= lastPage; page++) {
+        u8 state = m_pageStates[page].exchange(Pinned, std::memory_order_relaxed);
+        if (state == Pinned)
+            continue;
+
+        if (state != Unmapped)
+            std::erase(m_cache.m_residentPages, std::pair(this, page));
+        m_cache.m_pinnedPageCount++;
+
+        // Read now, so the first frame doesn't fault on them
+        volatile u8 byte = m_file.data()[page * PAGE_SIZE];
+        (void)byte;
+    }
+}
+
+Ref<PageCache::PagedFile> PageCache::open(const std::filesystem::path& filePath) {
+    auto pagedFile = makeRef<PagedFile>(*this, MappedFile(filePath));
+
+    std::lock_guard lock(m_mutex);
+    m_mappedBytes += pagedFile->m_file.size();
+    return pagedFile;
+}
+
+PageCache::Stats PageCache::stats() const {
+    std::lock_guard lock(m_mutex);
+    return {
+        .hits = m_hits.load(std::memory_order_relaxed),
+        .misses = m_misses,
+        .evictions = m_evictions,
+        .residentBytes = (m_residentPages.size() + m_pinnedPageCount) * PAGE_SIZE,
+        .pinnedBytes = m_pinnedPageCount * PAGE_SIZE,
+        .mappedBytes = m_mappedBytes,
+    };
+}
+
+void PageCache::pageIn(PagedFile& file, size_t page) {
+    std::lock_guard lock(m_mutex);
+
+    u8 state = file.m_pageStates[page].load(std::memory_order_relaxed);
+    if (state != Unmapped) {
+        // Paged in by another thread meanwhile
+        if (state != Pinned)
+            file.m_pageStates[page].store(Referenced, std::memory_order_relaxed);
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    file.m_pageStates[page].store(Referenced, std::memory_order_relaxed);
+    m_residentPages.emplace_back(&file, page);
+    m_misses++;
+
+    // Clock eviction, at least one page stays resident
+    while (m_residentPages.size() * PAGE_SIZE > m_memoryBudget && m_residentPages.size() > 1) {
+        m_clockHand %= m_residentPages.size();
+        auto [residentFile, residentPage] = m_residentPages[m_clockHand];
+        auto& residentState = residentFile->m_pageStates[residentPage];
+
+        u8 expected = Idle;
+        if (!residentState.compare_exchange_strong(expected, Unmapped, std::memory_order_relaxed)) {
+            // Referenced since the last pass, give it a second chance
+            residentState.store(Idle, std::memory_order_relaxed);
+            m_clockHand++;
+            continue;
+        }
+
+        residentFile->m_file.discard(residentPage * PAGE_SIZE, PAGE_SIZE);
+        m_residentPages[m_clockHand] = m_residentPages.back();
+        m_residentPages.pop_back();
+        m_evictions++;
+    }
+}
+
+void PageCache::release(PagedFile& file) {
+    std::lock_guard lock(m_mutex);
+
+    size_t pinnedPageCount = 0;
+    size_t pageCount = (file.m_file.size() + PAGE_SIZE - 1) / PAGE_SIZE;
+    for (size_t i = 0; i < pageCount; i++)
+        pinnedPageCount += file.m_pageStates[i].load(std::memory_order_relaxed) == Pinned;
+
+    std::erase_if(m_residentPages, [&](const auto& residentPage) { return residentPage.first == &file; });
+    m_pinnedPageCount -= pinnedPageCount;
+    m_mappedBytes -= file.m_file.size();
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "IO/MappedFile.h"
+
+/*
+ * @brief Memory mapped files paged in on first access, with their resident pages tracked under a shared memory budget.
+ *
+ * When the resident pages exceed the memory budget, the least recently used ones are evicted with the clock algorithm.
+ * Evicting a page only drops it from memory, the next access reads it from the file again, so readers never have to wait for the cache.
+ *
+ * @note The cache has to outlive its files.
+ */
+class PageCache {
+public:
+    static constexpr size_t PAGE_SIZE = 64 * 1024;  // Multiple of the OS page size and mapping granularity
+
+    struct Stats {
+        u64 hits = 0;  // Reads of resident pages, counted in batches per thread
+        u64 misses = 0;
+        u64 evictions = 0;
+        size_t residentBytes = 0;  // Including the pinned pages
+        size_t pinnedBytes = 0;
+        size_t mappedBytes = 0;
+    };
+
+    class PagedFile {
+    public:
+        MappedFile m_file;
+
+        PagedFile(PageCache& cache, MappedFile&& file);
+
+        PagedFile(const PagedFile&) = delete;
+
+        PagedFile& operator=(const PagedFile&) = delete;
+
+        ~PagedFile();
+
+        /*
+         * @param address Address in the mapped file about to be read.
+         */
+        inline void touch(const void* address) {
+            size_t page = (static_cast<const u8*>(address) - m_file.data()) / PAGE_SIZE;
+
+            u8 state = m_pageStates[page].load(std::memory_order_relaxed);
+            if (state == Unmapped) {
+                m_cache.pageIn(*this, page);
+                return;
+            }
+
+            if (state == Idle)
+                m_pageStates[page].compare_exchange_strong(state, Referenced, std::memory_order_relaxed);
+
+            if (++t_pendingHits == HIT_BATCH_SIZE) {
+                m_cache.m_hits.fetch_add(HIT_BATCH_SIZE, std::memory_order_relaxed);
+                t_pendingHits = 0;
+            }
+        }
+
+        /*
+         * @brief Pages in a range of the file and keeps it resident, pinned pages don't count against the memory budget.
+         */
+        void pin(size_t offset, size_t size);
+
+    private:
+        PageCache& m_cache;
+        std::unique_ptr<std::atomic<u8>[]> m_pageStates;
+
+        friend class PageCache;
+    };
+
+    size_t m_memoryBudget = (size_t)1 << 30;  // Bytes of resident pages
+
+    PageCache() = default;
+
+    PageCache(const PageCache&) = delete;
+
+    PageCache& operator=(const PageCache&) = delete;
+
+    /*
+     * @brief Maps a file, none of its pages are resident until touched.
+     */
+    Ref<PagedFile> open(const std::filesystem::path& filePath);
+
+    Stats stats() const;
+
+private:
+    static constexpr u32 HIT_BATCH_SIZE = 1024;
+
+    enum PageState : u8 {
+        Unmapped,
+        Referenced,  // Resident and read since the clock hand last passed
+        Idle,        // Resident, evicted when the clock hand passes again
+        Pinned,      // Resident until the file is closed, not in the clock ring
+    };
+
+    static inline thread_local u32 t_pendingHits = 0;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::pair<PagedFile*, size_t>> m_residentPages;  // Clock ring
+    size_t m_clockHand = 0;
+    size_t m_pinnedPageCount = 0;
+    size_t m_mappedBytes = 0;
+    std::atomic<u64> m_hits = 0;
+    u64 m_misses = 0;
+    u64 m_evictions = 0;
+
+    void pageIn(PagedFile& file, size_t page);
+
+    void release(PagedFile& file);
+};
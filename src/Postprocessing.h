@@ -20,7 +20,7 @@ inline u8vec3 hdrToSRGB(const vec3& color, f32 gamma = 2.2f) {
     return u8vec3(output * 255.0f);                 // convert to 8-bit
 }
 
-inline Texture<u8vec3> hdrToSRGB(const Texture<vec3>& texture, f32 gamma = 2.2f) {
+inline Texture<u8vec3> hdrToSRGB(TextureView<vec3> texture, f32 gamma = 2.2f) {
     Texture<u8vec3> output(texture.size());
     NODEBUG_ONLY(_Pragma("omp parallel for"))
     for (u32 y = 0; y < texture.size().y; y++) {
@@ -9,6 +9,10 @@ struct Ray {
     vec3 invDirection;
     Interval<f32> tInterval = RAY_INITIAL_INTERVAL;
 
+    // Ray cone for texture filtering
+    f32 coneWidth = 0;   // Width at the origin
+    f32 coneSpread = 0;  // Spread angle in radians
+
 #ifdef BVH_TEST
     u32 aabbTestCount = 0;
     u32 triangleTestCount = 0;
@@ -23,6 +27,24 @@ struct Ray {
         return origin + t * direction;
     }
 
+    /*
+     * @return Width of the ray cone at t.
+     */
+    inline f32 coneWidthAt(f32 t) const {
+        return coneWidth + coneSpread * t;
+    }
+
+    /*
+     * @brief Creates the ray continuing the path from the current hit at tInterval.max.
+     * @param addedSpread Spread angle added by the scattering lobe.
+     */
+    inline Ray scattered(const vec3& newOrigin, const vec3& newDirection, f32 addedSpread) const {
+        Ray ray(newOrigin, newDirection);
+        ray.coneWidth = coneWidthAt(tInterval.max);
+        ray.coneSpread = coneSpread + addedSpread;
+        return ray;
+    }
+
     inline Ray createTransformedRay(const mat4& transform) const {
         vec3 transformedOrigin = vec3(transform * vec4(origin, 1.0f));
         vec3 transformedDirection = vec3(transform * vec4(direction, 0.0f));
@@ -35,6 +57,8 @@ struct Ray {
             transformedTInterval.max = tInterval.max * transformedDirectionLength;
 
         Ray transformedRay(transformedOrigin, transformedDirection / transformedDirectionLength, transformedTInterval);
+        transformedRay.coneWidth = coneWidth * transformedDirectionLength;  // Distances scale with the direction
+        transformedRay.coneSpread = coneSpread;
 
 #ifdef BVH_TEST
         transformedRay.aabbTestCount = aabbTestCount;
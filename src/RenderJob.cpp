@@ -0,0 +1,62 @@
+#include "RenderJob.h"
+
+#include <sstream>
+
+void RenderJob::apply(Renderer& renderer) const {
+    renderer.m_imageSize = imageSize.value_or(renderer.m_imageSize);
+    renderer.m_samples = samples.value_or(renderer.m_samples);
+    renderer.m_seed = seed.value_or(renderer.m_seed);
+    renderer.m_timeBudget = timeBudget;
+    renderer.m_targetError = targetError;
+}
+
+void RenderJob::apply(Camera& camera) const {
+    camera.m_position = camera.m_lookAt + glm::angleAxis(glm::radians(orbit), camera.m_up) * (camera.m_position - camera.m_lookAt);
+    if (fov)
+        camera.m_fov = *fov;
+}
+
+RenderJob parseRenderJob(const std::string& line) {
+    std::istringstream tokens(line);
+    RenderJob job;
+    if (!(tokens >> job.name))
+        throw std::runtime_error("Missing job name");
+
+    // The name is the output folder of the job, it must stay inside the output folder
+    std::filesystem::path namePath(job.name);
+    if (namePath.filename() != namePath || job.name == "." || job.name == ".." || job.name.find_first_of("/\\:") != std::string::npos)
+        throw std::runtime_error(std::format("Invalid job name {}, it has to be a plain folder name", job.name));
+
+    std::string token;
+    while (tokens >> token) {
+        size_t separator = token.find('=');
+        if (separator == std::string::npos)
+            throw std::runtime_error(std::format("Invalid job option {} of {}", token, job.name));
+
+        std::string key = token.substr(0, separator);
+        std::string value = token.substr(separator + 1);
+
+        if (key == "scene")
+            job.sceneIndex = std::stoul(value);
+        else if (key == "orbit")
+            job.orbit = std::stof(value);
+        else if (key == "fov")
+            job.fov = std::stof(value);
+        else if (key == "width")
+            job.imageSize = uvec2(std::stoul(value), job.imageSize.value_or(uvec2(640, 480)).y);
+        else if (key == "height")
+            job.imageSize = uvec2(job.imageSize.value_or(uvec2(640, 480)).x, std::stoul(value));
+        else if (key == "samples")
+            job.samples = std::stoul(value);
+        else if (key == "seed")
+            job.seed = std::stoull(value);
+        else if (key == "time-budget")
+            job.timeBudget = std::chrono::milliseconds((i64)(std::stod(value) * 1000));
+        else if (key == "target-error")
+            job.targetError = std::stof(value);
+        else
+            throw std::runtime_error(std::format("Unknown job option {} of {}", key, job.name));
+    }
+
+    return job;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Renderer.h"
+
+/*
+ * @brief Description of a single image to render, the scene camera and renderer settings are overridden by the set fields.
+ */
+struct RenderJob {
+    std::string name;
+    u32 sceneIndex = 2;
+    f32 orbit = 0;  // Rotation of the scene camera around its look at point in degrees
+    std::optional<f32> fov;
+    std::optional<uvec2> imageSize;
+    std::optional<u32> samples;
+    std::optional<u64> seed;
+    std::chrono::milliseconds timeBudget = std::chrono::milliseconds(0);
+    f32 targetError = 0;
+
+    /*
+     * @brief Applies the job settings to a renderer.
+     */
+    void apply(Renderer& renderer) const;
+
+    /*
+     * @brief Applies the job settings to a copy of the scene camera.
+     */
+    void apply(Camera& camera) const;
+};
+
+/*
+ * @brief Parses a job from a line "<name> [key=value ...]", the name has to be a plain folder name without separators.
+ *
+ * Keys: scene, orbit, fov, width, height, samples, seed, time-budget (seconds), target-error
+ */
+RenderJob parseRenderJob(const std::string& line);
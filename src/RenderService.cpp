@@ -0,0 +1,285 @@
+#include "RenderService.h"
+
+#include "Postprocessing.h"
+#include "SnapshotWorker.h"
+
+struct JobCancelled : std::exception {
+    const char* what() const noexcept override { return "Job cancelled"; }
+};
+
+bool RenderService::Connection::send(const std::string& line, const void* data, size_t size) {
+    std::scoped_lock lock(sendMutex);
+    if (closed)
+        return false;
+
+    std::string header = line + '\n';
+    if (!socket.send(header.data(), header.size()) || (size != 0 && !socket.send(data, size)))
+        closed = true;
+
+    return !closed;
+}
+
+RenderService::RenderService(SceneLoader sceneLoader, RendererFactory rendererFactory, OutputHandler outputHandler)
+    : m_sceneLoader(std::move(sceneLoader)), m_rendererFactory(std::move(rendererFactory)), m_outputHandler(std::move(outputHandler)) {}
+
+void RenderService::run() {
+    m_listenSocket = Socket::listen(m_port);
+    LOG(std::format("Render service listening on 127.0.0.1:{}", m_port));
+
+    std::vector<std::thread> workers;
+    for (u32 i = 0; i < std::max(1U, m_maxActiveJobs); i++)
+        workers.emplace_back(&RenderService::runWorker, this);
+
+    while (true) {
+        Socket client = m_listenSocket.accept();
+
+        {
+            std::scoped_lock lock(m_queueMutex);
+            if (m_stopping)
+                break;
+        }
+
+        if (!client.isValid())
+            continue;
+
+        reapConnections();
+
+        auto connection = makeRef<Connection>();
+        connection->socket = std::move(client);
+        m_connections.push_back(connection);
+        m_connectionThreads.emplace_back(&RenderService::serveConnection, this, connection);
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    for (auto& connection : m_connections)
+        connection->socket.shutdown();
+    for (auto& thread : m_connectionThreads)
+        thread.join();
+
+    m_listenSocket.close();
+    LOG("Render service stopped");
+}
+
+void RenderService::stop() {
+    {
+        std::scoped_lock lock(m_queueMutex);
+        m_stopping = true;
+    }
+
+    m_queueCondition.notify_all();
+    Socket::connect(m_port);  // Wake up the accept loop
+}
+
+void RenderService::serveConnection(Ref<Connection> connection) {
+    std::string line;
+    while (connection->socket.readLine(line)) {
+        if (line.empty())
+            continue;
+
+        if (line == "quit") {
+            if (m_allowQuit)
+                stop();
+            else
+                connection->send("error - Quitting is disabled, start the service with --allow-quit");
+            continue;
+        }
+
+        RenderJob job;
+        try {
+            job = parseRenderJob(line);
+        }
+        catch (const std::exception& e) {
+            connection->send(std::format("error - {}", e.what()));
+            continue;
+        }
+
+        {
+            std::scoped_lock lock(m_queueMutex);
+            if (m_stopping) {
+                connection->send(std::format("error {} Service is stopping", job.name));
+                continue;
+            }
+
+            m_queue.push_back({.id = m_nextJobId++, .job = job, .connection = connection});
+        }
+
+        m_queueCondition.notify_one();
+        connection->send(std::format("queued {}", job.name));
+    }
+
+    connection->closed = true;  // Running jobs of the connection are cancelled
+    connection->served = true;
+}
+
+void RenderService::reapConnections() {
+    for (size_t i = 0; i < m_connections.size();) {
+        if (!m_connections[i]->served) {
+            i++;
+            continue;
+        }
+
+        // Queued jobs keep their own reference to the connection
+        m_connectionThreads[i].join();
+        m_connectionThreads.erase(m_connectionThreads.begin() + i);
+        m_connections.erase(m_connections.begin() + i);
+    }
+}
+
+void RenderService::runWorker() {
+    while (true) {
+        QueuedJob queuedJob;
+
+        {
+            std::unique_lock lock(m_queueMutex);
+            m_queueCondition.wait(lock, [this] { return !m_queue.empty() || m_stopping; });
+
+            if (m_queue.empty())
+                return;  // Stopped with nothing left to render
+
+            queuedJob = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        if (queuedJob.connection->closed)
+            continue;
+
+        try {
+            renderJob(queuedJob);
+        }
+        catch (const JobCancelled&) {
+            LOG(std::format("Job {} cancelled, the client disconnected", queuedJob.job.name));
+        }
+        catch (const std::exception& e) {
+            LOG(std::format("Job {} failed: {}", queuedJob.job.name, e.what()));
+            queuedJob.connection->send(std::format("error {} {}", queuedJob.job.name, e.what()));
+        }
+    }
+}
+
+void RenderService::renderJob(const QueuedJob& queuedJob) {
+    u64 jobId = queuedJob.id;
+    const RenderJob& job = queuedJob.job;
+    const Ref<Connection>& connection = queuedJob.connection;
+
+    auto [world, sceneCamera] = getScene(job.sceneIndex);
+    auto camera = makeRef<Camera>(*sceneCamera);
+    job.apply(*camera);
+
+    Renderer renderer = m_rendererFactory();
+    job.apply(renderer);
+
+    auto sendSnapshot = [&](const Texture<vec3>& color, u32 sample) {
+        auto colorSRGB = hdrToSRGB(color);
+        connection->send(std::format("snapshot {} {} {} {}", job.name, sample, color.size().x, color.size().y), colorSRGB.data(), (size_t)color.size().x * color.size().y * sizeof(u8vec3));
+    };
+
+    // Snapshots are resolved and sent while the job waits for its next turn
+    SnapshotWorker snapshotWorker([&](const AccumulationBuffer& accumulation, u32 sample) {
+        sendSnapshot(accumulation.resolve((u32)OutputChannel::Color).color, sample);
+    });
+
+    auto nextSnapshot = std::chrono::high_resolution_clock::now();
+    renderer.m_sampleCallback = [&](const AccumulationBuffer& accumulation, u32 sample) {
+        if (connection->closed)
+            throw JobCancelled();
+
+        auto currentTime = std::chrono::high_resolution_clock::now();
+        if (nextSnapshot <= currentTime && accumulation.channels() & (u32)OutputChannel::Color) {
+            snapshotWorker.publish(accumulation, sample);
+            nextSnapshot = currentTime + m_snapshotInterval;
+        }
+
+        passTurn(jobId);
+    };
+
+    AccumulationBuffer accumulation;
+    enterTurns(jobId);
+    try {
+        accumulation = renderer.accumulateFrame(world, camera);
+    }
+    catch (...) {
+        leaveTurns(jobId);
+        throw;
+    }
+    leaveTurns(jobId);
+
+    snapshotWorker.flush();
+
+    auto output = accumulation.resolve();
+    output.renderTime = renderer.stats().renderTime;
+    output.sampleCount = renderer.stats().sampleCount;
+    output.estimatedError = renderer.stats().estimatedError;
+    if (renderer.m_outputChannels & (u32)OutputChannel::Color)
+        sendSnapshot(output.color, output.sampleCount);
+
+    {
+        std::scoped_lock lock(m_outputMutex);
+        m_outputHandler(job, output, renderer.m_outputChannels);
+    }
+
+    connection->send(std::format("done {} {} {} {:.3f}", job.name, output.sampleCount, output.estimatedError, output.renderTime.count() / 1e6));
+}
+
+std::pair<Ref<World>, Ref<Camera>> RenderService::getScene(u32 sceneIndex) {
+    std::unique_lock lock(m_sceneMutex);
+
+    // Loaded or being loaded, jobs of other scenes don't wait for the load
+    auto it = m_scenes.find(sceneIndex);
+    if (it != m_scenes.end()) {
+        auto scene = it->second;
+        lock.unlock();
+        return scene.get();  // Rethrows if the load failed
+    }
+
+    std::promise<std::pair<Ref<World>, Ref<Camera>>> promise;
+    m_scenes[sceneIndex] = promise.get_future().share();
+    lock.unlock();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::pair<Ref<World>, Ref<Camera>> scene;
+    try {
+        scene = m_sceneLoader(sceneIndex);
+        scene.first->frameBegin();
+    }
+    catch (...) {
+        // Later jobs of the scene try loading it again
+        promise.set_exception(std::current_exception());
+        lock.lock();
+        m_scenes.erase(sceneIndex);
+        throw;
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    LOG(std::format("Scene {} loaded in {:.2f}s", sceneIndex, std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() / 1000.0));
+
+    promise.set_value(scene);
+    return scene;
+}
+
+void RenderService::enterTurns(u64 jobId) {
+    std::unique_lock lock(m_turnMutex);
+    m_turns.push_back(jobId);
+    m_turnCondition.wait(lock, [&] { return m_turns.front() == jobId; });
+}
+
+void RenderService::passTurn(u64 jobId) {
+    std::unique_lock lock(m_turnMutex);
+    if (m_turns.size() == 1)
+        return;  // Nobody else is waiting
+
+    m_turns.pop_front();
+    m_turns.push_back(jobId);
+    m_turnCondition.notify_all();
+    m_turnCondition.wait(lock, [&] { return m_turns.front() == jobId; });
+}
+
+void RenderService::leaveTurns(u64 jobId) {
+    {
+        std::scoped_lock lock(m_turnMutex);
+        std::erase(m_turns, jobId);
+    }
+
+    m_turnCondition.notify_all();
+}
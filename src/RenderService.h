@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "IO/Socket.h"
+#include "RenderJob.h"
+
+/*
+ * @brief Long running render server on localhost, scenes stay loaded between jobs.
+ *
+ * Clients send one job per line in the parseRenderJob format, or "quit" to stop the service if m_allowQuit is set, and receive
+ *   "queued <name>"                               when the job was accepted
+ *   "snapshot <name> <sample> <width> <height>"   followed by width * height * 3 bytes of sRGB color
+ *   "done <name> <samples> <error> <seconds>"     when the job has finished
+ *   "error <name> <message>"                      when the job has failed
+ *
+ * Active jobs take turns in rendering one sample of the whole frame on all threads,
+ * so short jobs aren't stuck behind long ones.
+ */
+class RenderService {
+public:
+    using SceneLoader = std::function<std::pair<Ref<World>, Ref<Camera>>(u32)>;
+    using RendererFactory = std::function<Renderer()>;
+    using OutputHandler = std::function<void(const RenderJob&, const RenderOutput&, u32)>;  // Called for one job at a time
+
+    u16 m_port = 7878;
+    u32 m_maxActiveJobs = 4;  // Jobs sharing the turns, the rest waits in the queue
+    std::chrono::milliseconds m_snapshotInterval = std::chrono::seconds(1);
+    bool m_allowQuit = false;  // Lets any client stop the service, otherwise only the process can be stopped
+
+    RenderService(SceneLoader sceneLoader, RendererFactory rendererFactory, OutputHandler outputHandler);
+
+    /*
+     * @brief Serves clients until one of them sends "quit" with m_allowQuit set, queued jobs are finished before returning.
+     */
+    void run();
+
+private:
+    struct Connection {
+        Socket socket;
+        std::mutex sendMutex;
+        std::atomic<bool> closed = false;
+        std::atomic<bool> served = false;  // Set when its thread is about to return, the thread can be joined
+
+        bool send(const std::string& line, const void* data = nullptr, size_t size = 0);
+    };
+
+    struct QueuedJob {
+        u64 id;
+        RenderJob job;
+        Ref<Connection> connection;
+    };
+
+    SceneLoader m_sceneLoader;
+    RendererFactory m_rendererFactory;
+    OutputHandler m_outputHandler;
+    std::mutex m_outputMutex;
+
+    Socket m_listenSocket;
+    std::vector<Ref<Connection>> m_connections;
+    std::vector<std::thread> m_connectionThreads;  // Thread of the connection at the same index
+
+    // Job queue
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueCondition;
+    std::deque<QueuedJob> m_queue;
+    u64 m_nextJobId = 0;
+    bool m_stopping = false;
+
+    // Round robin turns of the active jobs, the job in front renders
+    std::mutex m_turnMutex;
+    std::condition_variable m_turnCondition;
+    std::deque<u64> m_turns;
+
+    // Warm scene cache, jobs of a scene being loaded wait for that load
+    std::mutex m_sceneMutex;
+    std::map<u32, std::shared_future<std::pair<Ref<World>, Ref<Camera>>>> m_scenes;
+
+    void stop();
+
+    void serveConnection(Ref<Connection> connection);
+
+    void reapConnections();
+
+    void runWorker();
+
+    void renderJob(const QueuedJob& queuedJob);
+
+    std::pair<Ref<World>, Ref<Camera>> getScene(u32 sceneIndex);
+
+    void enterTurns(u64 jobId);
+
+    void passTurn(u64 jobId);
+
+    void leaveTurns(u64 jobId);
+};
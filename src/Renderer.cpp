@@ -1,109 +1,192 @@
 #include "Renderer.h"
 
-template <typename T>
-inline T runningAverage(const T& previousValue, const T& currentValue, u32 currentSampleCount) {
-    if (currentSampleCount == 1)
-        return currentValue;
-
-    // Check for NaNs
-    if constexpr (std::is_floating_point_v<T>) {
-        if (std::isnan(currentValue))
-            return previousValue;
-        if (std::isnan(previousValue))
-            return currentValue;
-    }
-    else if constexpr (std::is_same_v<T, vec3>) {
-        if (glm::any(glm::isnan(currentValue)))
-            return previousValue;
-        if (glm::any(glm::isnan(previousValue)))
-            return currentValue;
+Renderer::Output Renderer::renderFrame(Ref<World> world, Ref<Camera> camera) {
+    auto output = accumulateFrame(world, camera).resolve();
+    output.renderTime = m_stats.renderTime;
+    output.sampleCount = m_stats.sampleCount;
+    output.estimatedError = m_stats.estimatedError;
+    return output;
+}
+
+AccumulationBuffer Renderer::accumulateFrame(Ref<World> world, Ref<Camera> camera, AccumulationBuffer&& resumeFrom, u32 resumeSampleCount) {
+    if (m_partitionCount == 0 || m_partitionIndex >= m_partitionCount)
+        throw std::runtime_error("Invalid sample partition");
+
+    u32 errorChannels = (u32)OutputChannel::Color | (u32)OutputChannel::Variance;
+    if (m_targetError > 0 && (m_outputChannels & errorChannels) != errorChannels)
+        throw std::runtime_error("Error target requires the color and variance channels");
+
+    uvec2 regionSize = m_regionSize == uvec2(0) ? m_imageSize : m_regionSize;
+    if (glm::any(m_regionOffset + regionSize > m_imageSize))
+        throw std::runtime_error("Region of interest exceeds the image");
+
+    FrameContext frame = {
+        .world = *world,
+        .camera = *camera,
+        .sampleStratasPerAxis = std::max(1U, (u32)std::sqrt(m_samples)),
+        .regionMin = m_regionOffset,
+        .regionMax = m_regionOffset + regionSize,
+    };
+
+    frame.camera.initialize(m_imageSize);
+    world->frameBegin();
+
+    m_stats = Stats();
+
+    if (!m_outputChannels)
+        return AccumulationBuffer();
+
+    AccumulationBuffer accumulation;
+    if (resumeSampleCount != 0) {
+        if (resumeFrom.size() != m_imageSize || resumeFrom.channels() != m_outputChannels)
+            throw std::runtime_error("Resumed accumulation differs in size or channels");
+
+        accumulation = std::move(resumeFrom);
     }
     else
-        static_assert(false);
+        accumulation = AccumulationBuffer(m_imageSize, m_outputChannels);
+
+    // One instantiation of the sampling loop for every channel combination
+    static constexpr auto sampleFrameVariants = []<u32... Channels>(std::integer_sequence<u32, Channels...>) {
+        return std::array{&Renderer::sampleFrame<Channels>...};
+    }(std::make_integer_sequence<u32, OUTPUT_CHANNEL_MASK + 1>());
+    auto sampleFrameVariant = sampleFrameVariants[m_outputChannels & OUTPUT_CHANNEL_MASK];
 
-    return (previousValue * (f32)(currentSampleCount - 1) + currentValue) / f32(currentSampleCount);
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Coarse levels of the first sample
+    u32 sampleCount = partitionSampleCount();
+    if (resumeSampleCount == 0 && sampleCount != 0) {
+        for (u32 level = std::min(m_progressiveLevels, MAX_PROGRESSIVE_LEVELS); level > 0; level--) {
+            m_stats.rayCount += (this->*sampleFrameVariant)(frame, accumulation, 1, 1U << level);
+            if (m_levelCallback)
+                m_levelCallback(accumulation, 1U << level);
+        }
+    }
+
+    // Accumulate samples of this partition
+    m_stats.sampleCount = resumeSampleCount;
+    for (u32 sampleNum = resumeSampleCount + 1; sampleNum <= sampleCount; sampleNum++) {
+        m_stats.rayCount += (this->*sampleFrameVariant)(frame, accumulation, sampleNum, 1);
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+        m_stats.renderTime = elapsed;
+        m_stats.sampleTime = elapsed / (sampleNum - resumeSampleCount);
+        m_stats.sampleCount = sampleNum;
+        // The budget keeps the last estimate in between, it only stops sampling on a fresh one
+        u32 interval = std::max(1U, m_errorEstimateInterval);
+        if (m_targetError > 0 && sampleNum >= m_minSamples && (sampleNum - m_minSamples) % interval == 0)
+            m_stats.estimatedError = accumulation.estimateError();
+
+        if (m_sampleCallback)
+            m_sampleCallback(accumulation, sampleNum);
+
+        if (budgetReached())
+            break;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    m_stats.renderTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+    m_stats.estimatedError = accumulation.estimateError();
+
+    return accumulation;
 }
 
-Renderer::Output Renderer::renderFrame(Ref<World> world, Ref<Camera> camera) {
-    m_world = world;
-    m_camera = camera;
-    m_sampleStratasPerAxis = std::max(1U, (u32)std::sqrt(m_samples));
-
-    m_camera->initialize(m_imageSize);
-    m_world->hierarchy.frameBegin();
-
-    Output output{
-        .color = Texture<vec3>(m_outputChannels & (u32)OutputChannel::Color ? m_imageSize : uvec2(0)),
-        .depth = Texture<f32>(m_outputChannels & (u32)OutputChannel::Depth ? m_imageSize : uvec2(0)),
-        .normal = Texture<vec3>(m_outputChannels & (u32)OutputChannel::Normal ? m_imageSize : uvec2(0)),
-        .albedo = Texture<vec3>(m_outputChannels & (u32)OutputChannel::Albedo ? m_imageSize : uvec2(0)),
-        .emission = Texture<vec3>(m_outputChannels & (u32)OutputChannel::Emission ? m_imageSize : uvec2(0)),
-#ifdef BVH_TEST
-        .aabbTestCount = Texture<f32>(m_outputChannels & (u32)OutputChannel::AABBTestCount ? m_imageSize : uvec2(0)),
-        .triangleTestCount = Texture<f32>(m_outputChannels & (u32)OutputChannel::TriangleTestCount ? m_imageSize : uvec2(0)),
-#endif
-    };
+bool Renderer::budgetReached() const {
+    if (m_stats.sampleCount < m_minSamples)
+        return false;
 
-    if (!m_outputChannels)
-        return output;
+    // Sample times are stable enough within a frame to predict the next one from the average
+    if (m_timeBudget.count() > 0 && m_stats.renderTime + m_stats.sampleTime > m_timeBudget)
+        return true;
 
-    // Accumulate samples
-    for (u32 sampleNum = 1; sampleNum <= m_samples; sampleNum++) {
-        sampleFrame(output, sampleNum);
-        m_sampleCallback(output, sampleNum);
+    if (m_targetError > 0 && m_stats.estimatedError <= m_targetError)
+        return true;
+
+    return false;
+}
+
+u32 Renderer::predictSampleCount() const {
+    u32 sampleCount = partitionSampleCount();
+    if (m_stats.sampleCount < m_minSamples)
+        return sampleCount;
+
+    if (m_timeBudget.count() > 0 && m_stats.sampleTime.count() > 0) {
+        auto remainingTime = std::max(m_timeBudget - m_stats.renderTime, std::chrono::microseconds(0));
+        sampleCount = std::min(sampleCount, m_stats.sampleCount + (u32)(remainingTime / m_stats.sampleTime));
     }
 
-    return output;
+    // The error falls with the square root of the sample count
+    if (m_targetError > 0 && std::isfinite(m_stats.estimatedError)) {
+        f32 ratio = m_stats.estimatedError / m_targetError;
+        sampleCount = std::min(sampleCount, std::max(m_stats.sampleCount, (u32)std::ceil(m_stats.sampleCount * ratio * ratio)));
+    }
+
+    return sampleCount;
 }
 
-void Renderer::sampleFrame(Output& output, u32 sampleNum) const {
-    NODEBUG_ONLY(_Pragma("omp parallel for"))
-    for (u32 y = 0; y < m_imageSize.y; y++) {
-        uvec2 pixel = uvec2(0, y);
-        for (; pixel.x < m_imageSize.x; pixel.x++) {
-            vec2 pixelSamplePoint = randomVec2Stratified(m_sampleStratasPerAxis, sampleNum - 1);  // TODO progressive upping of resolution
-            Ray ray = m_camera->createRay(pixel, pixelSamplePoint);
-            PathSample sceneSample = samplePath(std::move(ray));
-
-            // TODO check error vs division after finishing
-            if (m_outputChannels & (u32)OutputChannel::Color)
-                output.color[pixel] = runningAverage(output.color[pixel], sceneSample.color, sampleNum);
-            if (m_outputChannels & (u32)OutputChannel::Depth)
-                output.depth[pixel] = runningAverage(output.depth[pixel], sceneSample.depth, sampleNum);
-            if (m_outputChannels & (u32)OutputChannel::Normal)
-                output.normal[pixel] = runningAverage(output.normal[pixel], sceneSample.normal, sampleNum);
-            if (m_outputChannels & (u32)OutputChannel::Albedo)
-                output.albedo[pixel] = runningAverage(output.albedo[pixel], sceneSample.albedo, sampleNum);
-            if (m_outputChannels & (u32)OutputChannel::Emission)
-                output.emission[pixel] = runningAverage(output.emission[pixel], sceneSample.emission, sampleNum);
-#ifdef BVH_TEST
-            if (m_outputChannels & (u32)OutputChannel::AABBTestCount)
-                output.aabbTestCount[pixel] = runningAverage(output.aabbTestCount[pixel], (f32)sceneSample.aabbTestCount, sampleNum);
-            if (m_outputChannels & (u32)OutputChannel::TriangleTestCount)
-                output.triangleTestCount[pixel] = runningAverage(output.triangleTestCount[pixel], (f32)sceneSample.triangleTestCount, sampleNum);
-#endif
+u32 Renderer::partitionSampleCount() const {
+    if (m_partitionIndex >= m_samples)
+        return 0;
+
+    return (m_samples - m_partitionIndex + m_partitionCount - 1) / m_partitionCount;
+}
+
+template <u32 Channels>
+u64 Renderer::sampleFrame(const FrameContext& frame, AccumulationBuffer& accumulation, u32 targetSampleCount, u32 stride) const {
+    u64 rayCount = 0;
+
+    // Pixels on the stride grid in image space, so coarse levels line up with the fill in AccumulationBuffer::resolve
+    uvec2 start = (frame.regionMin + stride - 1U) / stride * stride;
+
+    NODEBUG_ONLY(_Pragma("omp parallel for reduction(+ : rayCount)"))
+    for (i32 y = start.y; y < (i32)frame.regionMax.y; y += (i32)stride) {
+        uvec2 pixel = uvec2(start.x, y);
+        for (; pixel.x < frame.regionMax.x; pixel.x += stride) {
+            u32 pixelIndex = pixel.y * m_imageSize.x + pixel.x;
+
+            // Pixels can be ahead after coarse levels or a resumed render, the sample index continues from their own count
+            u32 pixelSampleCount = accumulation.sampleCount(pixelIndex);
+            if (pixelSampleCount >= targetSampleCount)
+                continue;
+
+            u32 sampleIndex = pixelSampleCount * m_partitionCount + m_partitionIndex;
+            Sampler sampler(m_samplerType, m_seed, pixelIndex, sampleIndex, frame.sampleStratasPerAxis);
+            Ray ray = frame.camera.createRay(pixel, sampler);
+            PathSample sceneSample = samplePath(frame, std::move(ray), sampler);
+            rayCount += sceneSample.rayCount;
+
+            accumulation.accumulate<Channels>(pixelIndex, sceneSample);
         }
     }
+
+    return rayCount;
 }
 
-Renderer::PathSample Renderer::samplePath(Ray&& ray) const {
+PathSample Renderer::samplePath(const FrameContext& frame, Ray&& ray, Sampler& sampler) const {
     PathSample output;
+    output.color = tracePath(frame, ray, sampler, vec3(1), 0, &output, m_splitCount > 1, output.rayCount);
+
+    return output;
+}
 
-    vec3 attenuation = vec3(1);
+vec3 Renderer::tracePath(const FrameContext& frame, Ray& ray, Sampler& sampler, vec3 attenuation, u32 firstBounce, PathSample* output, bool allowSplit, u32& rayCount) const {
     vec3 incomingLight = vec3(0);
-    bool sampledNonDeltaBounce = false;
+    bool sampledNonDeltaBounce = output == nullptr;
 
-    for (u32 bounceNum = 0; bounceNum <= m_maxBounces; bounceNum++) {
-        auto [hit, scatterOutput] = sampleRay(ray);
+    for (u32 bounceNum = firstBounce; bounceNum <= m_maxBounces; bounceNum++) {
+        HitRecord surfaceHit;
+        auto [hit, scatterOutput] = sampleRay(frame, ray, sampler, rayCount, allowSplit ? &surfaceHit : nullptr);
 
         incomingLight += attenuation * scatterOutput.emission;
+        vec3 vertexAttenuation = attenuation;
         attenuation *= scatterOutput.albedo;
 
-        if (bounceNum == 0) {
-            output.depth = std::isinf(ray.tInterval.max) ? 0.0f : 1.0f / (ray.tInterval.max + 1.0f);  // Reverse depth
+        if (output && bounceNum == 0) {
+            output->depth = std::isinf(ray.tInterval.max) ? 0.0f : 1.0f / (ray.tInterval.max + 1.0f);  // Reverse depth
 #ifdef BVH_TEST
-            output.aabbTestCount = ray.aabbTestCount;
-            output.triangleTestCount = ray.triangleTestCount;
+            output->aabbTestCount = ray.aabbTestCount;
+            output->triangleTestCount = ray.triangleTestCount;
 #endif
         }
 
@@ -111,40 +194,68 @@ Renderer::PathSample Renderer::samplePath(Ray&& ray) const {
             // Only sample for first non-delta bounce
             sampledNonDeltaBounce = true;
 
-            output.normal = hit.normal;  // * 0.5f + 0.5f;
-            output.albedo = scatterOutput.albedo;
-            output.emission = scatterOutput.emission;
+            output->normal = hit.normal;  // * 0.5f + 0.5f;
+            output->albedo = scatterOutput.albedo;
+            output->emission = scatterOutput.emission;
         }
 
         if (!scatterOutput.didScatter || glm::all(attenuation < vec3(1e-6f)))
             break;  // Early termination
 
-        ray = Ray(hit.point, scatterOutput.scatterDirection);  // Bounce ray
-    }
+        if (allowSplit && !scatterOutput.isTransmission && bounceNum < m_maxBounces) {
+            // Split the path at the first non-delta vertex, each branch carries 1/n of the throughput
+            allowSplit = false;
+            f32 splitWeight = 1.0f / m_splitCount;
+            attenuation *= splitWeight;
 
-    output.color = incomingLight;
+            for (u32 i = 1; i < m_splitCount; i++) {
+                HitRecord branchHit = surfaceHit;
+                ScatterOutput branchScatter = hit.material->scatterFunction(*hit.material, ray, branchHit, sampler);
+                if (!branchScatter.didScatter)
+                    continue;
 
-    return output;
+                Ray branchRay = ray.scattered(hit.point, branchScatter.scatterDirection, branchScatter.coneSpread);
+                incomingLight += tracePath(frame, branchRay, sampler, vertexAttenuation * branchScatter.albedo * splitWeight, bounceNum + 1, nullptr, false, rayCount);
+            }
+        }
+
+        if (m_russianRoulette && bounceNum >= m_russianRouletteMinBounces) {
+            // Survival probability proportional to the path throughput
+            f32 survivalProbability = std::min(1.0f, glm::compMax(attenuation));
+            if (sampler.get1D() >= survivalProbability)
+                break;
+
+            attenuation /= survivalProbability;
+        }
+
+        ray = ray.scattered(hit.point, scatterOutput.scatterDirection, scatterOutput.coneSpread);  // Bounce ray
+    }
+
+    return incomingLight;
 }
 
-std::pair<HitRecord, ScatterOutput> Renderer::sampleRay(Ray& ray) const {
+std::pair<HitRecord, ScatterOutput> Renderer::sampleRay(const FrameContext& frame, Ray& ray, Sampler& sampler, u32& rayCount, HitRecord* surfaceHit) const {
     while (true) {
-        HitRecord hit = m_world->hierarchy.hit(ray);
+        HitRecord hit = frame.world.hierarchy.hit(ray);
+        rayCount++;
 
         if (!hit.hit) {
             hit.hit = true;
-            hit.material = m_world->environmentMaterial;
+            hit.material = frame.world.environmentMaterial;
         }
 
         hit.point = ray.at(ray.tInterval.max);
 
+        if (surfaceHit)
+            *surfaceHit = hit;  // Keep the hit before scattering modifies it
+
         ScatterOutput scatterOutput;
         if (hit.material->scatterFunction)
-            scatterOutput = hit.material->scatterFunction(*hit.material, ray, hit);
+            scatterOutput = hit.material->scatterFunction(*hit.material, ray, hit, sampler);
         else {
             LOG(std::format("Scatter function not set for material: {}", hit.material->name));
             scatterOutput = {
-                .scatterDirection = hit.normal + randomUnitVec<3>()};
+                .scatterDirection = hit.normal + squareToUnitSphere(sampler.get2D())};
         }
 
         if (!hit.hit) {
@@ -1,64 +1,109 @@
 #pragma once
 
+#include <bit>
+
+#include "AccumulationBuffer.h"
 #include "Camera.h"
 #include "World.h"
 
 class Renderer {
 public:
-    enum class OutputChannel : u32 {
-        Color = BIT(0),
-        Depth = BIT(1),
-        Normal = BIT(2),
-        Albedo = BIT(3),
-        Emission = BIT(4),
-#ifdef BVH_TEST
-        AABBTestCount = BIT(5),
-        TriangleTestCount = BIT(6),
-#endif
-    };
+    using OutputChannel = ::OutputChannel;
+    using Output = RenderOutput;
 
-    struct Output {
-        Texture<vec3> color;
-        Texture<f32> depth;
-        Texture<vec3> normal;
-        Texture<vec3> albedo;
-        Texture<vec3> emission;
-#ifdef BVH_TEST
-        Texture<f32> aabbTestCount;
-        Texture<f32> triangleTestCount;
-#endif
-    };
+    static constexpr u32 MAX_PROGRESSIVE_LEVELS = std::countr_zero(AccumulationBuffer::MAX_FILL_STRIDE);  // Coarser levels couldn't be filled
 
-    struct PathSample {
-        vec3 color = vec3(0);
-        f32 depth = INFINITY;
-        vec3 normal = vec3(NAN);
-        vec3 albedo = vec3(NAN);
-        vec3 emission = vec3(NAN);
-#ifdef BVH_TEST
-        u32 aabbTestCount = NAN;
-        u32 triangleTestCount = NAN;
-#endif
+    struct Stats {
+        std::chrono::microseconds renderTime;
+        std::chrono::microseconds sampleTime;  // Average time of one sample of the whole frame
+        u64 rayCount = 0;
+        u32 sampleCount = 0;        // Partition samples in the accumulation, including resumed ones
+        f32 estimatedError = NAN;  // Estimated RMSE of the color, NaN without the variance channel
     };
 
     glm::uvec2 m_imageSize = glm::uvec2(256, 256);
-    u32 m_samples = 32;
+    u32 m_samples = 32;  // Upper limit of the sample count when a budget is set
     u32 m_maxBounces = 10;
 
+    SamplerType m_samplerType = SamplerType::Sobol;
+    u64 m_seed = 0;
+
+    // Sample partitioning - renders only every m_partitionCount-th sample starting at m_partitionIndex,
+    // partitions rendered with the same seed can be merged into the full frame
+    u32 m_partitionIndex = 0;
+    u32 m_partitionCount = 1;
+
+    // Region of interest - only pixels in [m_regionOffset, m_regionOffset + m_regionSize) are sampled, zero size covers the whole image
+    uvec2 m_regionOffset = uvec2(0);
+    uvec2 m_regionSize = uvec2(0);
+
+    // Progressive levels - the first sample is rendered coarse to fine on pixel grids with a stride of 2^m_progressiveLevels ... 2,
+    // every level only adds the pixels missing from the previous ones, so no samples are wasted. Clamped to MAX_PROGRESSIVE_LEVELS.
+    u32 m_progressiveLevels = 0;
+
+    // Budgets - sampling stops once the next sample wouldn't fit into the time budget or the estimated error
+    // drops below the target, zero disables a budget, the error target requires the color and variance channels
+    std::chrono::milliseconds m_timeBudget = std::chrono::milliseconds(0);
+    f32 m_targetError = 0;
+    u32 m_minSamples = 4;  // Samples before the error estimate is trusted
+    u32 m_errorEstimateInterval = 8;  // Samples between error estimates, every estimate reads the whole buffer
+
+    // Russian roulette - paths are terminated with a probability based on their throughput, survivors are reweighted
+    bool m_russianRoulette = true;
+    u32 m_russianRouletteMinBounces = 3;  // Bounces before russian roulette kicks in
+
+    // Path splitting - number of secondary paths traced from the first non-delta vertex, 1 disables splitting
+    u32 m_splitCount = 1;
+
     u32 m_outputChannels = (u32)OutputChannel::Color;
 
-    std::function<void(const Output&, u32)> m_sampleCallback;
+    std::function<void(const AccumulationBuffer&, u32)> m_sampleCallback;  // Resolve the buffer only when needed
+    std::function<void(const AccumulationBuffer&, u32)> m_levelCallback;   // Called after each progressive level with its stride
 
+    /*
+     * @brief Renders and resolves a frame.
+     *
+     * The world and camera are only read, frames of the same world can be rendered concurrently by separate renderers.
+     */
     Output renderFrame(Ref<World> world, Ref<Camera> camera);
 
+    /*
+     * @brief Renders the samples of the current partition without resolving them.
+     * @param resumeFrom Accumulation of an interrupted render to continue from, rendered with the same settings.
+     * @param resumeSampleCount Number of partition samples already in resumeFrom.
+     */
+    AccumulationBuffer accumulateFrame(Ref<World> world, Ref<Camera> camera, AccumulationBuffer&& resumeFrom = AccumulationBuffer(), u32 resumeSampleCount = 0);
+
+    u32 partitionSampleCount() const;
+
+    /*
+     * @brief Predicts the final partition sample count from the budgets and the current stats.
+     * @return The expected number of samples, the partition sample count without budgets.
+     */
+    u32 predictSampleCount() const;
+
+    const Stats& stats() const { return m_stats; }
+
 private:
-    Ref<World> m_world;
-    Ref<Camera> m_camera;
-    u32 m_sampleStratasPerAxis;
+    // State of a single frame, the renderer itself only holds settings and stats
+    struct FrameContext {
+        const World& world;
+        Camera camera;  // Initialized copy, the shared camera stays untouched
+        u32 sampleStratasPerAxis;
+        uvec2 regionMin;
+        uvec2 regionMax;  // Exclusive
+    };
+
+    Stats m_stats;
+
+    bool budgetReached() const;
+
+    template <u32 Channels>
+    u64 sampleFrame(const FrameContext& frame, AccumulationBuffer& accumulation, u32 targetSampleCount, u32 stride) const;
 
-    void sampleFrame(Output& output, u32 sampleNum) const;
+    PathSample samplePath(const FrameContext& frame, Ray&& ray, Sampler& sampler) const;
 
-    PathSample samplePath(Ray&& ray) const;
+    vec3 tracePath(const FrameContext& frame, Ray& ray, Sampler& sampler, vec3 attenuation, u32 firstBounce, PathSample* output, bool allowSplit, u32& rayCount) const;
 
-    std::pair<HitRecord, ScatterOutput> sampleRay(Ray& ray) const;
+    std::pair<HitRecord, ScatterOutput> sampleRay(const FrameContext& frame, Ray& ray, Sampler& sampler, u32& rayCount, HitRecord* surfaceHit = nullptr) const;
 };
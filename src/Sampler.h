@@ -0,0 +1,135 @@
+#pragma once
+
+enum class SamplerType : u8 {
+    Independent,  // Independent random numbers, stratified pixel positions
+    Sobol,        // Owen scrambled Sobol (0, 2)-sequence, shuffled per dimension pair
+};
+
+/*
+ * @brief Source of uniform samples for a single pixel sample.
+ *
+ * The generated values are fully determined by the seed, pixel and sample index,
+ * so the rendered image doesn't depend on thread scheduling.
+ */
+class Sampler {
+public:
+    /*
+     * @param type The type of the sequence to generate.
+     * @param seed The seed of the whole frame.
+     * @param pixelIndex Linear index of the pixel.
+     * @param sampleIndex Index of the sample in the pixel.
+     * @param strataPerAxis Pixel strata count per axis, only used by the independent sampler.
+     */
+    Sampler(SamplerType type, u64 seed, u32 pixelIndex, u32 sampleIndex, u32 strataPerAxis = 1)
+        : m_type(type),
+          m_pixelSeed(hash(seed ^ hash(pixelIndex))),
+          m_sampleIndex(sampleIndex),
+          m_strataPerAxis(strataPerAxis),
+          m_generator(m_pixelSeed ^ hash(sampleIndex)) {}
+
+    /*
+     * @return A uniform sample in [0, 1) for the next dimension.
+     */
+    inline f32 get1D() {
+        if (m_type == SamplerType::Independent)
+            return toUnitFloat((u32)(m_generator() >> 32));
+
+        u32 seed = (u32)hash(m_pixelSeed + m_dimension++);
+        u32 index = nestedUniformScramble(m_sampleIndex, seed);
+        return toUnitFloat(nestedUniformScramble(sobol0(index), seed ^ 0x9e3779b9U));
+    }
+
+    /*
+     * @return A uniform sample in [0, 1)^2 for the next pair of dimensions.
+     */
+    inline vec2 get2D() {
+        if (m_type == SamplerType::Independent)
+            return vec2(get1D(), get1D());
+
+        u32 seed = (u32)hash(m_pixelSeed + m_dimension++);
+        u32 index = nestedUniformScramble(m_sampleIndex, seed);
+        return vec2(
+            toUnitFloat(nestedUniformScramble(sobol0(index), seed ^ 0x9e3779b9U)),
+            toUnitFloat(nestedUniformScramble(sobol1(index), seed ^ 0x7f4a7c15U)));
+    }
+
+    /*
+     * @return The sample position inside the pixel in [0, 1)^2.
+     *
+     * @note Should be the first sample drawn, so the pixel positions get the best distributed dimensions.
+     */
+    inline vec2 getPixel2D() {
+        if (m_type == SamplerType::Independent)
+            return randomStratified();
+
+        return get2D();
+    }
+
+private:
+    SamplerType m_type;
+    u64 m_pixelSeed;
+    u32 m_sampleIndex;
+    u32 m_strataPerAxis;
+    u32 m_dimension = 0;
+    Xoshiro256SS m_generator;
+
+    vec2 randomStratified() {
+        vec2 offset = vec2(m_sampleIndex % m_strataPerAxis, (m_sampleIndex / m_strataPerAxis) % m_strataPerAxis);
+        return (get2D() + offset) / (f32)m_strataPerAxis;
+    }
+
+    // https://jcgt.org/published/0009/04/01/paper.pdf
+
+    static constexpr std::array<u32, 32> SOBOL_DIRECTIONS_1 = [] {
+        std::array<u32, 32> directions = {};
+        directions[0] = 1U << 31;
+        for (u32 i = 1; i < 32; i++)
+            directions[i] = directions[i - 1] ^ (directions[i - 1] >> 1);
+        return directions;
+    }();
+
+    static constexpr inline u32 reverseBits(u32 x) {
+        x = ((x >> 1) & 0x55555555U) | ((x & 0x55555555U) << 1);
+        x = ((x >> 2) & 0x33333333U) | ((x & 0x33333333U) << 2);
+        x = ((x >> 4) & 0x0f0f0f0fU) | ((x & 0x0f0f0f0fU) << 4);
+        x = ((x >> 8) & 0x00ff00ffU) | ((x & 0x00ff00ffU) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    // First Sobol dimension, the van der Corput sequence
+    static constexpr inline u32 sobol0(u32 index) {
+        return reverseBits(index);
+    }
+
+    // Second Sobol dimension
+    static constexpr inline u32 sobol1(u32 index) {
+        u32 result = 0;
+        for (u32 bit = 0; index != 0; index >>= 1, bit++) {
+            if (index & 1)
+                result ^= SOBOL_DIRECTIONS_1[bit];
+        }
+        return result;
+    }
+
+    static constexpr inline u32 laineKarrasPermutation(u32 x, u32 seed) {
+        x += seed;
+        x ^= x * 0x6c50b47cU;
+        x ^= x * 0xb82f1e52U;
+        x ^= x * 0xc7afe638U;
+        x ^= x * 0x8d22f6e6U;
+        return x;
+    }
+
+    // Owen scrambling
+    static constexpr inline u32 nestedUniformScramble(u32 x, u32 seed) {
+        return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+    }
+
+    static constexpr inline u64 hash(u64 value) {
+        return SplitMix64(value)();
+    }
+
+    static constexpr inline f32 toUnitFloat(u32 value) {
+        return (value >> 8) * 0x1p-24f;  // 24 bits so the result stays below 1
+    }
+};
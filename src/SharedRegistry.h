@@ -0,0 +1,167 @@
+#pragma once
+
+#include <future>
+#include <mutex>
+
+/*
+ * @brief Shares loaded assets by key, the base of the texture and geometry registries.
+ *
+ * The registry only keeps weak references, an asset is freed once nothing uses it.
+ * A load reserves its key with acquire, concurrent loads of the key wait for the reservation instead of loading it again.
+ * @param T Type of the assets, void for assets of different types that the caller casts back.
+ */
+template <typename T>
+class SharedRegistry {
+public:
+    struct Stats {
+        u32 loadCount = 0;    // Assets actually loaded
+        u32 sharedCount = 0;  // Loads served by an already loaded asset
+        size_t bytesSaved = 0;
+    };
+
+    /*
+     * @brief Key reserved by acquire, the caller loads its asset and finishes the reservation.
+     *
+     * Destroying an unfinished reservation fails the loads waiting for it, later loads of the key try again.
+     */
+    class Reservation {
+    public:
+        Reservation(SharedRegistry& registry, std::string key, std::promise<Ref<T>>&& promise)
+            : m_registry(registry), m_key(std::move(key)), m_promise(std::move(promise)) {}
+
+        Reservation(const Reservation&) = delete;
+
+        Reservation& operator=(const Reservation&) = delete;
+
+        ~Reservation() {
+            if (!m_isFinished)
+                fail(std::make_exception_ptr(std::runtime_error("Loading the shared asset failed")));
+        }
+
+        /*
+         * @brief Registers the finished asset under the reserved key and hands it to the waiting loads.
+         * @param dataSize Bytes saved by every later load that shares the asset.
+         */
+        void finish(const Ref<T>& asset, size_t dataSize) {
+            m_registry.release(m_key, asset, dataSize);
+            m_promise.set_value(asset);
+            m_isFinished = true;
+        }
+
+        /*
+         * @brief Rethrows exception in the waiting loads, the key is left free for the next load.
+         */
+        void fail(std::exception_ptr exception) {
+            m_registry.release(m_key, nullptr, 0);
+            m_promise.set_exception(exception);
+            m_isFinished = true;
+        }
+
+    private:
+        SharedRegistry& m_registry;
+        std::string m_key;
+        std::promise<Ref<T>> m_promise;
+        bool m_isFinished = false;
+    };
+
+    SharedRegistry() = default;
+
+    SharedRegistry(const SharedRegistry&) = delete;
+
+    SharedRegistry& operator=(const SharedRegistry&) = delete;
+
+    /*
+     * @brief Returns the asset of a key, waiting for a pending load of it, or reserves the key for the caller to load.
+     * @param reservation Set if the key was reserved, the caller has to finish it.
+     * @return The shared asset, null if the key was reserved.
+     */
+    Ref<T> acquire(const std::string& key, Ref<Reservation>& reservation) {
+        std::unique_lock lock(m_mutex);
+        auto& entry = m_entries[key];
+        if (auto asset = entry.asset.lock()) {
+            countShared(entry.dataSize);
+            return asset;
+        }
+
+        if (entry.pending.valid()) {
+            auto pending = entry.pending;
+            lock.unlock();
+
+            auto asset = pending.get();  // Rethrows if the first load failed
+            lock.lock();
+            countShared(entry.dataSize);
+            return asset;
+        }
+
+        std::promise<Ref<T>> promise;
+        entry.pending = promise.get_future().share();
+        reservation = makeRef<Reservation>(*this, key, std::move(promise));
+        return nullptr;
+    }
+
+    /*
+     * @brief Returns the asset registered under a key without reserving it.
+     * @param isMatch Checks the asset before it is shared.
+     * @return The shared asset, null if there is none or isMatch rejected it.
+     */
+    template <typename F>
+    Ref<T> find(const std::string& key, F&& isMatch) {
+        std::lock_guard lock(m_mutex);
+        auto it = m_entries.find(key);
+        if (it == m_entries.end())
+            return nullptr;
+
+        auto asset = it->second.asset.lock();
+        if (!asset || !isMatch(*asset))
+            return nullptr;
+
+        countShared(it->second.dataSize);
+        return asset;
+    }
+
+    /*
+     * @brief Counts a loaded asset and registers it under a key, a still used asset of the same key is kept instead.
+     */
+    void add(const std::string& key, const Ref<T>& asset, size_t dataSize) {
+        std::lock_guard lock(m_mutex);
+        m_stats.loadCount++;
+
+        auto& entry = m_entries[key];
+        if (entry.asset.expired()) {
+            entry.asset = asset;
+            entry.dataSize = dataSize;
+        }
+    }
+
+    inline Stats stats() const {
+        std::lock_guard lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    struct Entry {
+        WeakRef<T> asset;
+        std::shared_future<Ref<T>> pending;  // Valid while the key is reserved
+        size_t dataSize = 0;
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;  // Elements keep their address when the map grows
+    Stats m_stats;
+
+    // Ends the reservation of a key, a null asset leaves the key free for the next load
+    void release(const std::string& key, const Ref<T>& asset, size_t dataSize) {
+        std::lock_guard lock(m_mutex);
+        auto& entry = m_entries[key];
+        entry.pending = {};
+        if (asset) {
+            entry.asset = asset;
+            entry.dataSize = dataSize;
+        }
+    }
+
+    inline void countShared(size_t dataSize) {
+        m_stats.sharedCount++;
+        m_stats.bytesSaved += dataSize;
+    }
+};
@@ -0,0 +1,65 @@
+#include "SnapshotWorker.h"
+
+SnapshotWorker::SnapshotWorker(Task task) : m_task(std::move(task)) {
+    m_thread = std::thread(&SnapshotWorker::run, this);
+}
+
+SnapshotWorker::~SnapshotWorker() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+void SnapshotWorker::publish(const AccumulationBuffer& accumulation, u32 sampleNum) {
+    {
+        std::lock_guard lock(m_mutex);
+        m_pending = accumulation;  // Reuses the allocation of the previous snapshot
+        m_pendingSampleNum = sampleNum;
+        m_hasPending = true;
+    }
+
+    m_condition.notify_all();
+}
+
+void SnapshotWorker::flush() {
+    std::unique_lock lock(m_mutex);
+    m_condition.wait(lock, [this] { return !m_hasPending && !m_busy; });
+}
+
+void SnapshotWorker::run() {
+    while (true) {
+        u32 sampleNum;
+
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_hasPending || m_stop; });
+
+            if (!m_hasPending)
+                return;  // Stopped with nothing left to process
+
+            std::swap(m_pending, m_processing);
+            sampleNum = m_pendingSampleNum;
+            m_hasPending = false;
+            m_busy = true;
+        }
+
+        // A failed snapshot only loses that snapshot, the worker keeps running and flush still returns
+        try {
+            m_task(m_processing, sampleNum);
+        }
+        catch (const std::exception& e) {
+            LOG("Snapshot of sample " << sampleNum << " failed: " << e.what());
+        }
+
+        {
+            std::lock_guard lock(m_mutex);
+            m_busy = false;
+        }
+
+        m_condition.notify_all();
+    }
+}
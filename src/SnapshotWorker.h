@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "AccumulationBuffer.h"
+
+/*
+ * @brief Runs a task on snapshots of an accumulation buffer on a background thread.
+ *
+ * Snapshots are double buffered, publishing only copies the buffer and never waits for the task.
+ * If the task is still busy, the pending snapshot is replaced by the newer one.
+ */
+class SnapshotWorker {
+public:
+    using Task = std::function<void(const AccumulationBuffer&, u32)>;
+
+    explicit SnapshotWorker(Task task);
+
+    SnapshotWorker(const SnapshotWorker&) = delete;
+
+    SnapshotWorker& operator=(const SnapshotWorker&) = delete;
+
+    ~SnapshotWorker();
+
+    /*
+     * @brief Copies the buffer and schedules the task on the copy.
+     * @param accumulation The buffer to snapshot.
+     * @param sampleNum The number of samples in the buffer.
+     */
+    void publish(const AccumulationBuffer& accumulation, u32 sampleNum);
+
+    /*
+     * @brief Waits until all published snapshots are processed.
+     */
+    void flush();
+
+private:
+    Task m_task;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::thread m_thread;
+
+    AccumulationBuffer m_pending;
+    AccumulationBuffer m_processing;
+    u32 m_pendingSampleNum = 0;
+    bool m_hasPending = false;
+    bool m_busy = false;
+    bool m_stop = false;
+
+    void run();
+};
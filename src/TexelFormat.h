@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glm/gtc/packing.hpp>
+
+/*
+ * Texel storage formats
+ *
+ * A texture of value type T can store its texels as:
+ *  - T itself, f32 components
+ *  - u8 / glm::vec<L, u8>, 8 bit unsigned normalized components
+ *  - u16 / glm::vec<L, u16>, 16 bit unsigned normalized components
+ *  - HalfTexel<L>, half precision components
+ *
+ * Texels are decoded to T on sample and encoded from T on write.
+ */
+
+/*
+ * @brief Half precision storage of L components.
+ */
+template <glm::length_t L>
+struct HalfTexel {
+    glm::vec<L, u16> bits;
+
+    static constexpr glm::length_t length() { return L; }
+};
+
+template <typename T>
+struct IsHalfTexel : std::false_type {};
+
+template <glm::length_t L>
+struct IsHalfTexel<HalfTexel<L>> : std::true_type {};
+
+// Component type of a scalar or vector texel
+template <typename T>
+struct TexelComponent {
+    using Type = T;
+};
+
+template <glm::length_t L, typename T, glm::qualifier Q>
+struct TexelComponent<glm::vec<L, T, Q>> {
+    using Type = T;
+};
+
+template <typename T>
+constexpr glm::length_t texelComponentCount() {
+    if constexpr (std::is_arithmetic_v<T>)
+        return 1;
+    else
+        return T::length();
+}
+
+/*
+ * @return Name of the storage format, like unorm8x3 or halfx3.
+ */
+template <typename Storage>
+std::string texelFormatName() {
+    std::string componentName;
+    if constexpr (IsHalfTexel<Storage>::value)
+        componentName = "half";
+    else {
+        using Component = typename TexelComponent<Storage>::Type;
+        componentName = std::is_floating_point_v<Component> ? "f32" : std::format("unorm{}", sizeof(Component) * 8);
+    }
+
+    return std::format("{}x{}", componentName, texelComponentCount<Storage>());
+}
+
+/*
+ * @brief Decodes a stored texel to its value type.
+ */
+template <typename T, typename Storage>
+inline T decodeTexel(const Storage& texel) {
+    if constexpr (std::is_same_v<T, Storage>)
+        return texel;
+    else if constexpr (IsHalfTexel<Storage>::value) {
+        auto value = glm::unpackHalf(texel.bits);
+        if constexpr (std::is_arithmetic_v<T>)
+            return value.x;
+        else
+            return T(value);
+    }
+    else {
+        using Component = typename TexelComponent<Storage>::Type;
+        static_assert(std::is_unsigned_v<Component>, "Unsupported texel storage");
+
+        constexpr f32 scale = 1.0f / (f32)std::numeric_limits<Component>::max();
+        return T(texel) * scale;
+    }
+}
+
+/*
+ * @brief Encodes a value to the texel storage, normalized formats are clamped to [0, 1] and half formats to the largest finite half.
+ */
+template <typename Storage, typename T>
+inline Storage encodeTexel(const T& value) {
+    if constexpr (std::is_same_v<T, Storage>)
+        return value;
+    else if constexpr (IsHalfTexel<Storage>::value) {
+        // Brighter values would become infinite, and turn every filtered sample that touches them infinite too
+        constexpr f32 maxHalf = 65504.0f;
+        using HalfValue = glm::vec<texelComponentCount<T>(), f32>;
+        return Storage{glm::packHalf(glm::clamp(HalfValue(value), HalfValue(-maxHalf), HalfValue(maxHalf)))};
+    }
+    else {
+        using Component = typename TexelComponent<Storage>::Type;
+        static_assert(std::is_unsigned_v<Component>, "Unsupported texel storage");
+
+        constexpr f32 maxValue = (f32)std::numeric_limits<Component>::max();
+        return Storage(glm::round(glm::clamp(value, T(0), T(1)) * maxValue));
+    }
+}
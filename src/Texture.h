@@ -1,56 +1,164 @@
 #pragma once
 
-template <typename T>
+#include <atomic>
+#include <span>
+
+#include "TexelFormat.h"
+
+enum class TextureLayout : u8 {
+    Linear,  // Row-major texels
+    Tiled,   // Row-major tiles of TEXTURE_TILE_SIZE^2 row-major texels, keeps neighbouring rows in the same cache lines
+};
+
+constexpr u32 TEXTURE_TILE_SIZE = 8;
+constexpr u32 TEXTURE_SAMPLE_BATCH_SIZE = 16;  // UVs addressed together by the batched sampling
+
+#ifdef TEXTURE_TEST
+inline std::atomic<u64> TEXTURE_ALLOCATION_COUNT = 0;  // Texel allocations of all the textures, see testTextureSharing
+inline std::atomic<u64> TEXTURE_COPY_COUNT = 0;        // Texel copies of shared textures made unique
+#endif
+
+/*
+ * @return Index of the texel of a pixel in the raw texels of a texture.
+ */
+inline size_t texelIndex(const uvec2& size, TextureLayout layout, const uvec2& pixel) {
+    if (layout == TextureLayout::Linear)
+        return (size_t)pixel.y * size.x + pixel.x;
+
+    u32 tilesPerRow = (size.x + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+    uvec2 tile = pixel / TEXTURE_TILE_SIZE;
+    uvec2 inTile = pixel % TEXTURE_TILE_SIZE;
+    return ((size_t)tile.y * tilesPerRow + tile.x) * (TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE) + inTile.y * TEXTURE_TILE_SIZE + inTile.x;
+}
+
+/*
+ * @brief Gets notified of every texel read of textures with paged external texels.
+ */
+class ITexturePager {
+public:
+    virtual ~ITexturePager() = default;
+
+    /*
+     * @param texel Address of the texel about to be read.
+     */
+    virtual void touch(const void* texel) = 0;
+};
+
+/*
+ * @brief Non-owning read-only view of the texels of a texture.
+ *
+ * Valid while the texture is alive and not written to, used to pass textures around without copying them.
+ */
+template <typename T, typename Storage = T>
+class TextureView {
+public:
+    TextureView() = default;
+
+    TextureView(const uvec2& size, TextureLayout layout, const Storage* data) : m_size(size), m_layout(layout), m_data(data) {}
+
+    /*
+     * @return The decoded texel at the pixel coordinates.
+     */
+    inline const T fetch(const uvec2& uv) const {
+        return decodeTexel<T>((*this)[uv]);
+    }
+
+    inline const Storage& operator[](const uvec2& uv) const { return m_data[texelIndex(m_size, m_layout, uv % m_size)]; }
+
+    inline const uvec2& size() const { return m_size; }
+
+    inline TextureLayout layout() const { return m_layout; }
+
+    inline const Storage* data() const { return m_data; }
+
+private:
+    uvec2 m_size = uvec2(0);
+    TextureLayout m_layout = TextureLayout::Linear;
+    const Storage* m_data = nullptr;
+};
+
+/*
+ * @brief 2D texture with values of type T, stored as Storage texels.
+ *
+ * Sampling decodes the texels to T, see TexelFormat.h for the supported storage formats.
+ * The layout of the texels only affects the raw data, all the accessors take pixel coordinates.
+ *
+ * Copies share the texels (copy on write). A shared or external texture has to be made unique with makeUnique
+ * before it is written to, the mutable accessors don't copy the texels, so they are cheap in loops and across threads.
+ */
+template <typename T, typename Storage = T>
 class Texture {
 public:
     bool m_gammaCorrected = false;
 
     Texture() = default;
 
-    Texture(const uvec2& size, T*&& data = nullptr, bool gammaCorrected = false) : m_size(size), m_data(data), m_gammaCorrected(gammaCorrected) {
-        if (!m_data && size.x != 0 && size.y != 0)
-            m_data = new T[m_size.x * m_size.y];
+    /*
+     * @param data Texels allocated with new[], the texture takes their ownership. Allocated if null.
+     */
+    Texture(const uvec2& size, Storage*&& data = nullptr, bool gammaCorrected = false) : m_size(size), m_gammaCorrected(gammaCorrected) {
+        if (data)
+            setData(data);
+        else if (size.x != 0 && size.y != 0)
+            setData(new Storage[texelCount()]);
     }
 
-    Texture(const uvec2& size, const T& value, bool gammaCorrected = false) : m_size(size), m_data(new T[size.x * size.y]), m_gammaCorrected(gammaCorrected) {
+    Texture(const uvec2& size, const Storage& value, bool gammaCorrected = false) : m_size(size), m_gammaCorrected(gammaCorrected) {
+        setData(new Storage[texelCount()]);
         clear(value);
     }
 
-    Texture(const Texture& other) {
-        // TODO copy on write?
+    // Shares the texels
+    Texture(const Texture& other) = default;
 
+    Texture(Texture&& other) noexcept : m_mipLevels(std::move(other.m_mipLevels)), m_dataOwner(std::move(other.m_dataOwner)) {
         m_size = other.m_size;
+        m_layout = other.m_layout;
+        m_data = other.m_data;
         m_channels = other.m_channels;
-        m_data = new T[m_size.x * m_size.y];
         m_gammaCorrected = other.m_gammaCorrected;
+        m_isExternal = other.m_isExternal;
+        m_pager = other.m_pager;
 
-        if constexpr (std::is_trivially_copyable_v<T>) {
-            std::memcpy(m_data, other.m_data, m_size.x * m_size.y * sizeof(T));
-        }
-        else {
-            for (size_t i = 0; i < m_size.x * m_size.y; i++)
-                m_data[i] = other.m_data[i];
-        }
+        other.m_data = nullptr;
     }
 
-    Texture(Texture&& other) noexcept {
+    // Shares the texels
+    Texture& operator=(const Texture& other) = default;
+
+    Texture& operator=(Texture&& other) noexcept {
+        if (this == &other)
+            return *this;
+
         m_size = other.m_size;
+        m_layout = other.m_layout;
         m_data = other.m_data;
         m_channels = other.m_channels;
         m_gammaCorrected = other.m_gammaCorrected;
+        m_mipLevels = std::move(other.m_mipLevels);
+        m_dataOwner = std::move(other.m_dataOwner);
+        m_isExternal = other.m_isExternal;
+        m_pager = other.m_pager;
 
         other.m_data = nullptr;
+        return *this;
     }
 
-    Texture& operator=(const Texture& other) = delete;
-
-    Texture& operator=(Texture&& other) = delete;
-
-    ~Texture() {
-        if (!m_data)
-            return;
-
-        delete[] m_data;
+    /*
+     * @brief Creates a texture over texels it doesn't own, like a memory mapped file.
+     * @param data The texels, ordered by the layout, they are only read.
+     * @param owner Keeps the texels alive.
+     * @param pager Gets notified of texel reads, can be null.
+     */
+    static Texture external(const uvec2& size, TextureLayout layout, Storage* data, Ref<void> owner, ITexturePager* pager = nullptr) {
+        Texture texture;
+        texture.m_size = size;
+        texture.m_layout = layout;
+        texture.m_data = data;
+        texture.m_dataOwner = std::move(owner);
+        texture.m_isExternal = true;
+        texture.m_pager = pager;
+        return texture;
     }
 
     // Bilinear interpolation
@@ -66,48 +174,240 @@ public:
         if (txIsWhole && tyIsWhole) {
             // No interpolation needed
             sampleUV += glm::round(vec2(tx, ty));
-            return sample(uvec2(sampleUV));
+            return fetch(uvec2(sampleUV));
         }
 
         if (txIsWhole) {
             // Interpolate only in y
             sampleUV.x += round(tx);  // round(tx) is either 0 or 1
-            return (1 - ty) * sample(uvec2(sampleUV.x, sampleUV.y)) + ty * sample(uvec2(sampleUV.x, sampleUV.y + 1));
+            return (1 - ty) * fetch(uvec2(sampleUV.x, sampleUV.y)) + ty * fetch(uvec2(sampleUV.x, sampleUV.y + 1));
         }
 
         if (tyIsWhole) {
             // Interpolate only in x
             sampleUV.y += round(ty);
-            return (1 - tx) * sample(uvec2((sampleUV.x), sampleUV.y)) + ty * sample(uvec2(sampleUV.x + 1, sampleUV.y));
+            return (1 - tx) * fetch(uvec2((sampleUV.x), sampleUV.y)) + tx * fetch(uvec2(sampleUV.x + 1, sampleUV.y));
         }
 
-        T x0 = (1 - tx) * sample(uvec2(sampleUV.x, sampleUV.y)) + tx * sample(uvec2(sampleUV.x + 1, sampleUV.y));
-        T x1 = (1 - tx) * sample(uvec2(sampleUV.x, sampleUV.y + 1)) + tx * sample(uvec2(sampleUV.x + 1, sampleUV.y + 1));
+        T x0 = (1 - tx) * fetch(uvec2(sampleUV.x, sampleUV.y)) + tx * fetch(uvec2(sampleUV.x + 1, sampleUV.y));
+        T x1 = (1 - tx) * fetch(uvec2(sampleUV.x, sampleUV.y + 1)) + tx * fetch(uvec2(sampleUV.x + 1, sampleUV.y + 1));
 
         return x0 * (1 - ty) + x1 * ty;
     }
 
-    inline const T& sample(const vec2& uv) const {
+    /*
+     * @brief Bilinear interpolation of many uvs, for shading paths that process samples in batches.
+     *
+     * Every sample blends all four taps, without the whole texel special cases of sampleInterpolated,
+     * so the addressing and blending loops have no data dependent branches and can be vectorized.
+     * Texel addresses of a batch are computed before any texel is read.
+     *
+     * @param uvs The texture coordinates, wrapped like sampleInterpolated, negative ones included.
+     * @param results Receives the samples, at least as long as uvs.
+     */
+    void sampleInterpolated(std::span<const vec2> uvs, std::span<T> results) const {
+        constexpr u32 BATCH_SIZE = TEXTURE_SAMPLE_BATCH_SIZE;
+        ivec2 size = ivec2(m_size);
+
+        for (size_t batchStart = 0; batchStart < uvs.size(); batchStart += BATCH_SIZE) {
+            u32 count = (u32)std::min<size_t>(BATCH_SIZE, uvs.size() - batchStart);
+
+            // Taps are ordered (x0, y0), (x1, y0), (x0, y1), (x1, y1)
+            std::array<std::array<size_t, BATCH_SIZE>, 4> indices;
+            std::array<vec2, BATCH_SIZE> weights;
+            for (u32 i = 0; i < count; i++) {
+                vec2 texel = uvs[batchStart + i] * vec2(m_size);
+                vec2 texel0 = glm::floor(texel);
+                weights[i] = texel - texel0;
+
+                ivec2 pixel0 = (ivec2(texel0) % size + size) % size;
+                ivec2 pixel1 = (pixel0 + 1) % size;
+                indices[0][i] = texelIndex(uvec2(pixel0.x, pixel0.y));
+                indices[1][i] = texelIndex(uvec2(pixel1.x, pixel0.y));
+                indices[2][i] = texelIndex(uvec2(pixel0.x, pixel1.y));
+                indices[3][i] = texelIndex(uvec2(pixel1.x, pixel1.y));
+            }
+
+            if (m_pager) {
+                for (const auto& tapIndices : indices) {
+                    for (u32 i = 0; i < count; i++)
+                        m_pager->touch(&m_data[tapIndices[i]]);
+                }
+            }
+
+            for (u32 i = 0; i < count; i++) {
+                vec2 w = weights[i];
+                T x0 = decodeTexel<T>(m_data[indices[0][i]]) * (1 - w.x) + decodeTexel<T>(m_data[indices[1][i]]) * w.x;
+                T x1 = decodeTexel<T>(m_data[indices[2][i]]) * (1 - w.x) + decodeTexel<T>(m_data[indices[3][i]]) * w.x;
+                results[batchStart + i] = x0 * (1 - w.y) + x1 * w.y;
+            }
+        }
+    }
+
+    /*
+     * @brief Trilinear interpolation between the two MIP levels matching the footprint.
+     * @param uv The texture coordinates.
+     * @param footprint Width of the sampled area in uv units, from the ray cone.
+     */
+    const T sampleTrilinear(const vec2& uv, f32 footprint) const {
+        if (m_mipLevels.empty() || !(footprint > 0))
+            return sampleInterpolated(uv);
+
+        f32 level = glm::clamp(std::log2(footprint * (f32)glm::compMax(m_size)), 0.0f, (f32)m_mipLevels.size());
+        u32 lowerLevel = (u32)level;
+        f32 t = level - lowerLevel;
+
+        const T lower = mipLevel(lowerLevel).sampleInterpolated(uv);
+        if (t == 0 || lowerLevel == m_mipLevels.size())
+            return lower;
+
+        return lower * (1 - t) + mipLevel(lowerLevel + 1).sampleInterpolated(uv) * t;
+    }
+
+    /*
+     * @brief Generates the MIP pyramid down to 1x1 with a box filter, odd sizes are rounded down.
+     */
+    void generateMips() {
+        m_mipLevels.clear();
+
+        const Texture* previous = this;
+        while (glm::compMax(previous->m_size) > 1) {
+            uvec2 size = glm::max(previous->m_size / 2U, uvec2(1));
+            Texture level(size);
+            level.m_channels = m_channels;
+            level.m_gammaCorrected = m_gammaCorrected;
+
+            NODEBUG_ONLY(_Pragma("omp parallel for"))
+            for (i32 y = 0; y < (i32)size.y; y++) {
+                for (u32 x = 0; x < size.x; x++) {
+                    uvec2 source = glm::min(uvec2(x, y) * 2U, previous->m_size - 1U);
+                    uvec2 sourceNext = glm::min(source + 1U, previous->m_size - 1U);
+                    T average = (previous->fetch(source) +
+                                 previous->fetch(uvec2(sourceNext.x, source.y)) +
+                                 previous->fetch(uvec2(source.x, sourceNext.y)) +
+                                 previous->fetch(sourceNext)) *
+                                0.25f;
+                    level.m_data[y * size.x + x] = encodeTexel<Storage>(average);
+                }
+            }
+
+            level.setLayout(m_layout);
+            m_mipLevels.push_back(std::move(level));
+            previous = &m_mipLevels.back();
+        }
+    }
+
+    /*
+     * @brief Appends a level to the MIP pyramid, used for pyramids generated elsewhere.
+     */
+    void addMipLevel(Texture&& level) {
+        m_mipLevels.push_back(std::move(level));
+    }
+
+    /*
+     * @brief Reorders the texels of the texture and its MIP levels to the layout.
+     */
+    void setLayout(TextureLayout layout) {
+        for (auto& level : m_mipLevels)
+            level.setLayout(layout);
+
+        if (layout == m_layout)
+            return;
+
+        Texture reordered;
+        reordered.m_size = m_size;
+        reordered.m_layout = layout;
+        reordered.setData(new Storage[reordered.texelCount()]);
+
+        NODEBUG_ONLY(_Pragma("omp parallel for"))
+        for (i32 y = 0; y < (i32)m_size.y; y++) {
+            for (u32 x = 0; x < m_size.x; x++)
+                reordered.m_data[reordered.texelIndex(uvec2(x, y))] = m_data[texelIndex(uvec2(x, y))];
+        }
+
+        m_layout = layout;
+        m_data = reordered.m_data;
+        m_dataOwner = std::move(reordered.m_dataOwner);
+        m_isExternal = false;
+        m_pager = nullptr;
+    }
+
+    inline const Texture& mipLevel(u32 level) const { return level == 0 ? *this : m_mipLevels[level - 1]; }
+
+    inline u32 mipLevelCount() const { return (u32)m_mipLevels.size() + 1; }
+
+    inline const T sample(const vec2& uv) const {
         vec2 sampleUV = uv * vec2(m_size);
-        return sample(uvec2(sampleUV));
+        return fetch(uvec2(sampleUV));
+    }
+
+    /*
+     * @return The decoded texel at the pixel coordinates.
+     */
+    inline const T fetch(const uvec2& uv) const {
+        return decodeTexel<T>(sample(uv));
     }
 
-    inline const T& sample(const uvec2& uv) const {
+    inline const Storage& sample(const uvec2& uv) const {
         uvec2 sampleUV = uv % m_size;  // Repeat texture
-        return m_data[sampleUV.y * m_size.x + sampleUV.x];
+        const Storage& texel = m_data[texelIndex(sampleUV)];
+        if (m_pager)
+            m_pager->touch(&texel);
+        return texel;
     }
 
-    inline T& sample(const uvec2& uv) {
+    // The texture has to be unique, see makeUnique
+    inline Storage& sample(const uvec2& uv) {
+        assert(isUnique());
         uvec2 sampleUV = uv % m_size;  // Repeat texture
-        return m_data[sampleUV.y * m_size.x + sampleUV.x];
+        return m_data[texelIndex(sampleUV)];
+    }
+
+    inline const Storage& operator[](const uvec2& uv) const { return sample(uv); }
+
+    inline Storage& operator[](const uvec2& uv) { return sample(uv); }
+
+    /*
+     * @brief Converts the texture to another storage format, MIP levels are not converted.
+     */
+    template <typename OtherStorage>
+    Texture<T, OtherStorage> encoded() const {
+        Texture<T, OtherStorage> texture;
+        texture.m_size = m_size;
+        texture.m_layout = m_layout;
+        texture.m_gammaCorrected = m_gammaCorrected;
+        texture.setData(new OtherStorage[texelCount()]);
+
+        NODEBUG_ONLY(_Pragma("omp parallel for"))
+        for (i32 i = 0; i < (i32)texelCount(); i++)
+            texture.m_data[i] = encodeTexel<OtherStorage>(decodeTexel<T>(m_data[i]));
+
+        return texture;
     }
 
-    inline const T& operator[](const uvec2& uv) const { return sample(uv); }
+    /*
+     * @return Bytes of the texels of all the MIP levels, including external texels.
+     */
+    inline size_t dataSize() const {
+        size_t bytes = texelCount() * sizeof(Storage);
+        for (const auto& level : m_mipLevels)
+            bytes += level.dataSize();
+        return bytes;
+    }
 
-    inline T& operator[](const uvec2& uv) { return sample(uv); }
+    /*
+     * @return Bytes allocated for the texels of all the MIP levels, external texels are not counted.
+     */
+    inline size_t memoryUsage() const {
+        size_t bytes = m_isExternal ? 0 : texelCount() * sizeof(Storage);
+        for (const auto& level : m_mipLevels)
+            bytes += level.memoryUsage();
+        return bytes;
+    }
 
-    inline void clear(const T& value) {
-        for (size_t i = 0; i < m_size.x * m_size.y; i++)
+    inline void clear(const Storage& value) {
+        makeUnique();
+        for (size_t i = 0; i < texelCount(); i++)
             m_data[i] = value;
     }
 
@@ -115,10 +415,85 @@ public:
 
     inline const u8& channels() const { return m_channels; }
 
-    inline const T* data() const { return m_data; }
+    inline TextureLayout layout() const { return m_layout; }
+
+    /*
+     * @return The raw texels, ordered by the layout.
+     */
+    inline const Storage* data() const { return m_data; }
+
+    // The texture has to be unique, see makeUnique
+    inline Storage* data() {
+        assert(isUnique());
+        return m_data;
+    }
+
+    /*
+     * @brief Copies the texels if they are shared or external, call it once before writing to the texture.
+     */
+    inline void makeUnique() {
+        if (isUnique())
+            return;
+
+        auto sharedOwner = m_dataOwner;  // Keeps the texels alive while they are copied
+        const Storage* sharedData = m_data;
+        setData(new Storage[texelCount()]);
+        std::copy(sharedData, sharedData + texelCount(), m_data);
+#ifdef TEXTURE_TEST
+        TEXTURE_COPY_COUNT.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    inline TextureView<T, Storage> view() const { return TextureView<T, Storage>(m_size, m_layout, m_data); }
+
+    inline operator TextureView<T, Storage>() const { return view(); }
+
+    /*
+     * @return Whether the texels are shared with other textures.
+     */
+    inline bool isShared() const { return m_dataOwner.use_count() > 1; }
+
+    /*
+     * @return Whether the texels can be written to without affecting other textures.
+     */
+    inline bool isUnique() const { return !m_data || (!m_isExternal && !isShared()); }
+
+    /*
+     * @return Number of stored texels, tiled textures are padded to whole tiles.
+     */
+    inline size_t texelCount() const {
+        if (m_layout == TextureLayout::Linear)
+            return (size_t)m_size.x * m_size.y;
+
+        uvec2 tiles = (m_size + TEXTURE_TILE_SIZE - 1U) / TEXTURE_TILE_SIZE;
+        return (size_t)tiles.x * tiles.y * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE;
+    }
 
 private:
     uvec2 m_size = uvec2(0);
+    TextureLayout m_layout = TextureLayout::Linear;
     u8 m_channels = 0;
-    T* m_data = nullptr;
+    Storage* m_data = nullptr;
+    std::vector<Texture> m_mipLevels;  // Levels 1..n, level 0 is the texture itself
+    Ref<void> m_dataOwner;             // Keeps the texels alive, shared by copies
+    bool m_isExternal = false;         // The texels are read-only and not allocated by the texture
+    ITexturePager* m_pager = nullptr;
+
+    template <typename, typename>
+    friend class Texture;
+
+    // Takes the ownership of texels allocated with new[]
+    inline void setData(Storage* data) {
+#ifdef TEXTURE_TEST
+        TEXTURE_ALLOCATION_COUNT.fetch_add(1, std::memory_order_relaxed);
+#endif
+        m_data = data;
+        m_dataOwner = Ref<Storage[]>(data);
+        m_isExternal = false;
+        m_pager = nullptr;
+    }
+
+    inline size_t texelIndex(const uvec2& pixel) const {
+        return ::texelIndex(m_size, m_layout, pixel);
+    }
 };
@@ -0,0 +1,68 @@
+#include "TextureBenchmark.h"
+
+#include "IO/TextureIO.h"
+#include "Material.h"
+
+constexpr u32 UV_COUNT = 1 << 20;
+constexpr u32 NOISE_TEXTURE_SIZE = 4096;
+constexpr u32 BENCHMARK_BATCH_SIZE = 256;  // UVs passed to one batched sampling call
+
+template <typename T, typename Storage>
+static void benchmarkTexture(Texture<T, Storage>& texture, const std::vector<vec2>& uvs, u32 sampleCount) {
+    LOG(std::format("Sampling {}x{} {} texture {} times", texture.size().x, texture.size().y, texelFormatName<Storage>(), sampleCount));
+
+    for (auto layout : {TextureLayout::Linear, TextureLayout::Tiled}) {
+        texture.setLayout(layout);
+
+        auto report = [&](const std::string& path, std::chrono::microseconds time, const T& sum) {
+            LOG(std::format("{} {}: {:.2f}ms, {:.1f} Msamples/s (checksum {:.3f})",
+                            layout == TextureLayout::Linear ? "Linear" : "Tiled", path,
+                            time.count() / 1000.0, sampleCount / (f64)time.count(), glm::compAdd(glm::vec<texelComponentCount<T>(), f32>(sum)) / sampleCount));
+        };
+
+        // Checksums keep the samples from being optimized out, both paths should match
+        T sum = T(0);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (u32 i = 0; i < sampleCount; i++)
+            sum += texture.sampleInterpolated(uvs[i % UV_COUNT]);
+        report("scalar", std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start), sum);
+
+        sum = T(0);
+        std::vector<T> samples(BENCHMARK_BATCH_SIZE);
+        start = std::chrono::high_resolution_clock::now();
+        for (u32 i = 0; i < sampleCount; i += BENCHMARK_BATCH_SIZE) {
+            u32 count = std::min(BENCHMARK_BATCH_SIZE, sampleCount - i);
+            texture.sampleInterpolated(std::span(uvs).subspan(i % UV_COUNT, count), std::span(samples));
+            for (u32 j = 0; j < count; j++)
+                sum += samples[j];
+        }
+        report("batched", std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start), sum);
+    }
+}
+
+void benchmarkTextureSampling(const std::filesystem::path& filePath, u32 sampleCount) {
+    ColorTexture colorTexture;
+    AlphaTexture alphaTexture;
+    if (!filePath.empty()) {
+        colorTexture = loadTexture<vec3, u8vec3>(filePath, false, false);
+        alphaTexture = loadTexture<f32, u8>(filePath, false, false);
+    }
+    else {
+        colorTexture = ColorTexture(uvec2(NOISE_TEXTURE_SIZE));
+        alphaTexture = AlphaTexture(uvec2(NOISE_TEXTURE_SIZE));
+        for (u32 y = 0; y < NOISE_TEXTURE_SIZE; y++) {
+            for (u32 x = 0; x < NOISE_TEXTURE_SIZE; x++) {
+                colorTexture[uvec2(x, y)] = encodeTexel<u8vec3>(randomVec<3, f32>());
+                alphaTexture[uvec2(x, y)] = encodeTexel<u8>(random<f32>());
+            }
+        }
+    }
+
+    // The uvs are generated up front so only the sampling is measured
+    std::vector<vec2> uvs(UV_COUNT);
+    for (auto& uv : uvs)
+        uv = randomVec<2, f32>();
+
+    benchmarkTexture(colorTexture, uvs, sampleCount);
+    benchmarkTexture(alphaTexture, uvs, sampleCount);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+/*
+ * @brief Measures the throughput of scalar and batched bilinear sampling at random uvs for every texture layout.
+ * @param filePath The texture to sample as color and alpha, generated 4k noise textures if empty.
+ * @param sampleCount Samples taken per layout.
+ */
+void benchmarkTextureSampling(const std::filesystem::path& filePath, u32 sampleCount = 1 << 26);
@@ -0,0 +1,93 @@
+#include "TextureCache.h"
+
+#include <fstream>
+#include <thread>
+
+constexpr u32 TEXTURE_CACHE_FILE_MAGIC = 0x5854574c;  // "LWTX"
+// 2: half texels clamped to the finite half range, 16 bit files loaded at full precision
+constexpr u32 TEXTURE_CACHE_FILE_VERSION = 2;
+
+std::filesystem::path TextureCache::cacheFilePath(const std::filesystem::path& filePath, const std::string& formatName, bool flipVertically) const {
+    auto key = std::format("{}|{}|{}", std::filesystem::weakly_canonical(filePath).string(), formatName, flipVertically);
+    return m_folder / std::format("{}-{:016x}.lwtex", filePath.stem().string(), (u64)std::hash<std::string>()(key));
+}
+
+std::optional<TextureCache::FileHeader> TextureCache::readHeader(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath, u32 texelSize) const {
+    std::error_code cacheError, sourceError;
+    auto cacheTime = std::filesystem::last_write_time(cachePath, cacheError);
+    auto sourceTime = std::filesystem::last_write_time(sourcePath, sourceError);
+    if (cacheError || (!sourceError && cacheTime < sourceTime))
+        return std::nullopt;
+
+    std::ifstream file(cachePath, std::ios::binary);
+    FileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    bool isValid = file && header.magic == TEXTURE_CACHE_FILE_MAGIC && header.version == TEXTURE_CACHE_FILE_VERSION &&
+                   header.texelSize == texelSize && header.tileSize == TEXTURE_TILE_SIZE &&
+                   header.levelCount != 0 && header.levelCount <= MAX_LEVEL_COUNT;
+
+    // Every level, padded to whole tiles, has to fit in the file, truncated files are converted again
+    std::error_code sizeError;
+    u64 fileSize = std::filesystem::file_size(cachePath, sizeError);
+    for (u32 i = 0; isValid && i < header.levelCount; i++) {
+        u64 tilesX = ((u64)header.levelSizes[i].x + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+        u64 tilesY = ((u64)header.levelSizes[i].y + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+        u64 byteSize = tilesX * tilesY * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE * texelSize;
+        isValid = !sizeError && tilesX != 0 && tilesY != 0 && header.levelOffsets[i] % PAGE_SIZE == 0 &&
+                  header.levelOffsets[i] <= fileSize && byteSize <= fileSize - header.levelOffsets[i];
+    }
+
+    if (!isValid) {
+        LOG("Texture cache file " << cachePath << " is invalid");
+        return std::nullopt;
+    }
+
+    return header;
+}
+
+void TextureCache::writeCacheFile(const std::filesystem::path& cachePath, u32 texelSize, const std::vector<LevelData>& levels) const {
+    LOG("Saving texture cache file " << cachePath);
+
+    if (levels.size() > MAX_LEVEL_COUNT) {
+        LOG("Texture has too many MIP levels");
+        throw std::runtime_error("Texture has too many MIP levels");
+    }
+
+    FileHeader header = {
+        .magic = TEXTURE_CACHE_FILE_MAGIC,
+        .version = TEXTURE_CACHE_FILE_VERSION,
+        .texelSize = texelSize,
+        .tileSize = TEXTURE_TILE_SIZE,
+        .levelCount = (u32)levels.size(),
+        .reserved = 0,
+        .levelSizes = {},
+        .levelOffsets = {},
+    };
+
+    // Levels start on their own pages, so evicting a page never touches two levels
+    u64 offset = PAGE_SIZE;
+    for (size_t i = 0; i < levels.size(); i++) {
+        header.levelSizes[i] = levels[i].size;
+        header.levelOffsets[i] = offset;
+        offset += (levels[i].byteSize + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    }
+
+    // Written through a temporary file, so concurrent loads and crashes never see a partial file
+    std::filesystem::create_directories(m_folder);
+    auto temporaryPath = std::filesystem::path(cachePath).concat(std::format(".{:x}.tmp", (u64)std::hash<std::thread::id>()(std::this_thread::get_id())));
+    {
+        std::ofstream file(temporaryPath, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (size_t i = 0; i < levels.size(); i++) {
+            file.seekp(header.levelOffsets[i]);
+            file.write(static_cast<const char*>(levels[i].data), levels[i].byteSize);
+        }
+
+        if (!file) {
+            LOG("Saving texture cache file failed");
+            throw std::runtime_error("Saving texture cache file failed");
+        }
+    }
+    std::filesystem::rename(temporaryPath, cachePath);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "IO/TextureIO.h"
+#include "PageCache.h"
+#include "Texture.h"
+
+/*
+ * @brief Textures converted once to tiled, MIP mapped cache files, which are memory mapped and paged in on first access.
+ *
+ * With m_pageTexels set, the texel reads are tracked and the resident pages of all the mapped files are kept together
+ * under the memory budget, see PageCache. Otherwise the texels are read straight from the mapped files, the OS pages them.
+ *
+ * @note The cache has to outlive its textures.
+ */
+class TextureCache : public PageCache {
+public:
+    std::filesystem::path m_folder = "cache/textures";
+    bool m_pageTexels = false;  // Every texel read of a paged texture touches its page, only worth it under a tight budget
+
+    TextureCache() = default;
+
+    /*
+     * @brief Maps the cache file of a texture, converting the texture first if it is missing or outdated.
+     * @param filePath The source texture.
+     * @return The texture with its MIP levels, the texels are read-only.
+     */
+    template <typename T, typename Storage>
+    Ref<Texture<T, Storage>> load(const std::filesystem::path& filePath, bool flipVertically = false) {
+        auto cachePath = cacheFilePath(filePath, texelFormatName<Storage>(), flipVertically);
+
+        auto header = readHeader(cachePath, filePath, sizeof(Storage));
+        if (!header) {
+            auto texture = loadTexture<T, Storage>(filePath, flipVertically, true, TextureLayout::Tiled);
+
+            std::vector<LevelData> levels;
+            for (u32 i = 0; i < texture.mipLevelCount(); i++) {
+                const auto& level = texture.mipLevel(i);
+                levels.push_back({level.size(), level.data(), level.texelCount() * sizeof(Storage)});
+            }
+            writeCacheFile(cachePath, sizeof(Storage), levels);
+
+            header = readHeader(cachePath, filePath, sizeof(Storage));
+            if (!header) {
+                LOG("Failed to convert texture " << filePath);
+                throw std::runtime_error("Failed to convert texture");
+            }
+        }
+
+        // The pager keeps the file mapped either way
+        auto pager = makeRef<TexturePager>(open(cachePath));
+        ITexturePager* texelPager = m_pageTexels ? pager.get() : nullptr;
+        auto texelsAt = [&](u32 level) {
+            return reinterpret_cast<Storage*>(const_cast<u8*>(pager->m_file->m_file.data() + header->levelOffsets[level]));
+        };
+
+        auto texture = makeRef<Texture<T, Storage>>(Texture<T, Storage>::external(header->levelSizes[0], TextureLayout::Tiled, texelsAt(0), pager, texelPager));
+        for (u32 i = 1; i < header->levelCount; i++)
+            texture->addMipLevel(Texture<T, Storage>::external(header->levelSizes[i], TextureLayout::Tiled, texelsAt(i), pager, texelPager));
+
+        return texture;
+    }
+
+private:
+    static constexpr u32 MAX_LEVEL_COUNT = 32;
+
+    struct FileHeader {
+        u32 magic;
+        u32 version;
+        u32 texelSize;
+        u32 tileSize;
+        u32 levelCount;
+        u32 reserved;  // Aligns the arrays without padding, so no uninitialized bytes are written
+        std::array<uvec2, MAX_LEVEL_COUNT> levelSizes;
+        std::array<u64, MAX_LEVEL_COUNT> levelOffsets;  // Aligned to PAGE_SIZE
+    };
+
+    static_assert(sizeof(FileHeader) == 6 * sizeof(u32) + MAX_LEVEL_COUNT * (sizeof(uvec2) + sizeof(u64)), "The cache file header has padding");
+
+    struct LevelData {
+        uvec2 size;
+        const void* data;
+        size_t byteSize;
+    };
+
+    // Forwards the texel reads of the textures to their paged file
+    class TexturePager final : public ITexturePager {
+    public:
+        Ref<PagedFile> m_file;
+
+        explicit TexturePager(Ref<PagedFile> file) : m_file(std::move(file)) {}
+
+        void touch(const void* texel) override { m_file->touch(texel); }
+    };
+
+    std::filesystem::path cacheFilePath(const std::filesystem::path& filePath, const std::string& formatName, bool flipVertically) const;
+
+    std::optional<FileHeader> readHeader(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath, u32 texelSize) const;
+
+    void writeCacheFile(const std::filesystem::path& cachePath, u32 texelSize, const std::vector<LevelData>& levels) const;
+};
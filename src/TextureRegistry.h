@@ -0,0 +1,48 @@
+#pragma once
+
+#include "IO/TextureIO.h"
+#include "SharedRegistry.h"
+#include "TextureCache.h"
+
+/*
+ * @brief Shares loaded textures by their canonical path, storage format and flip.
+ *
+ * The registry only keeps weak references, a texture is freed once no material uses it.
+ * Concurrent loads of the same texture wait for the first one instead of loading it again.
+ */
+class TextureRegistry : public SharedRegistry<void> {
+public:
+    /*
+     * @param cache Cache to map the textures from, the textures are fully loaded if null.
+     */
+    explicit TextureRegistry(TextureCache* cache = nullptr) : m_cache(cache) {}
+
+    template <typename T, typename Storage>
+    Ref<Texture<T, Storage>> load(const std::filesystem::path& filePath, bool flipVertically = false) {
+        auto key = std::format("{}|{}|{}", std::filesystem::weakly_canonical(filePath).string(), texelFormatName<Storage>(), flipVertically);
+
+        Ref<Reservation> reservation;
+        if (auto texture = acquire(key, reservation))
+            return std::static_pointer_cast<Texture<T, Storage>>(texture);
+
+        Ref<Texture<T, Storage>> texture;
+        try {
+            if (m_cache)
+                texture = m_cache->load<T, Storage>(filePath, flipVertically);
+            else
+                texture = makeRef<Texture<T, Storage>>(loadTexture<T, Storage>(filePath, flipVertically, true, TextureLayout::Tiled));
+        }
+        catch (...) {
+            reservation->fail(std::current_exception());
+            throw;
+        }
+
+        // Counted as a load, the reservation then hands the texture to the waiting loads
+        add(key, texture, texture->dataSize());
+        reservation->finish(texture, texture->dataSize());
+        return texture;
+    }
+
+private:
+    TextureCache* m_cache;
+};
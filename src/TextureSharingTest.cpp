@@ -0,0 +1,119 @@
+#include "TextureSharingTest.h"
+
+#ifdef TEXTURE_TEST
+
+#include "IO/TextureIO.h"
+#include "Postprocessing.h"
+#include "SnapshotWorker.h"
+
+constexpr uvec2 TEST_TEXTURE_SIZE = uvec2(64, 32);
+constexpr u32 TEST_FRAME_SAMPLES = 4;
+constexpr u64 PREVIEW_ALLOCATIONS = 5;  // Resolved color, albedo and normal, the denoised color and its sRGB conversion
+
+bool testTextureSharing(const std::function<std::pair<Ref<World>, Ref<Camera>>()>& loadScene,
+                        const std::function<Renderer()>& createRenderer,
+                        const std::function<void(const AccumulationBuffer&, const std::filesystem::path&)>& savePreview,
+                        const std::function<void(const RenderOutput&, u32, const std::filesystem::path&)>& saveOutput) {
+    bool passed = true;
+
+    // Runs f and compares the texel allocations and copies it made, a negative expectation isn't checked. Returns the allocations.
+    auto expectCounts = [&](const std::string& name, i64 expectedAllocations, u64 expectedCopies, auto&& f) {
+        u64 allocationsBefore = TEXTURE_ALLOCATION_COUNT.load();
+        u64 copiesBefore = TEXTURE_COPY_COUNT.load();
+        f();
+        u64 allocations = TEXTURE_ALLOCATION_COUNT.load() - allocationsBefore;
+        u64 copies = TEXTURE_COPY_COUNT.load() - copiesBefore;
+
+        bool isExpected = (expectedAllocations < 0 || allocations == (u64)expectedAllocations) && copies == expectedCopies;
+        LOG(std::format("{}: {} allocations, {} copies, {} {} expected{}", name, allocations, copies,
+                        expectedAllocations < 0 ? "any" : std::to_string(expectedAllocations), expectedCopies, isExpected ? "" : " - FAILED"));
+        passed &= isExpected;
+        return allocations;
+    };
+
+    auto expect = [&](const std::string& name, bool condition) {
+        LOG(name << (condition ? ": passed" : ": FAILED"));
+        passed &= condition;
+    };
+
+    Texture<vec3> texture(TEST_TEXTURE_SIZE, vec3(1));
+
+    Texture<vec3> copy;
+    expectCounts("Copy", 0, 0, [&] {
+        Texture<vec3> constructed = texture;
+        copy = constructed;
+    });
+    expect("Copy shares the texels", std::as_const(copy).data() == std::as_const(texture).data());
+
+    expectCounts("Write to a copy", 1, 1, [&] {
+        copy.makeUnique();
+        for (u32 y = 0; y < copy.size().y; y++) {
+            for (u32 x = 0; x < copy.size().x; x++)
+                copy[uvec2(x, y)] = vec3(2);
+        }
+    });
+    expect("Write to a copy leaves the original", std::as_const(texture)[uvec2(0)] == vec3(1) && std::as_const(copy)[uvec2(0)] == vec3(2));
+
+    expectCounts("Write to a unique texture", 0, 0, [&] {
+        texture.makeUnique();
+        texture[uvec2(0)] = vec3(3);
+    });
+
+    auto folder = std::filesystem::temp_directory_path() / "longweekend-texture-test";
+    std::filesystem::create_directories(folder);
+
+    // A frame rendered the way the render mode renders it, every sample publishes a preview to the preview task
+    auto [world, camera] = loadScene();
+    Renderer renderer = createRenderer();
+    renderer.m_imageSize = TEST_TEXTURE_SIZE;
+    renderer.m_samples = TEST_FRAME_SAMPLES;
+
+    u64 previewCount = 0;  // Busy previews are replaced by newer ones, only the saved ones allocate
+    SnapshotWorker previewWorker([&](const AccumulationBuffer& accumulation, u32 sample) {
+        savePreview(accumulation, folder);
+        previewCount++;
+    });
+    renderer.m_sampleCallback = [&](const AccumulationBuffer& accumulation, u32 sample) { previewWorker.publish(accumulation, sample); };
+
+    AccumulationBuffer accumulation;
+    u64 frameAllocations = expectCounts("Frame with previews", -1, 0, [&] {
+        accumulation = renderer.accumulateFrame(world, camera);
+        previewWorker.flush();
+    });
+    expect(std::format("{} previews allocate only their own textures", previewCount), previewCount != 0 && frameAllocations == previewCount * PREVIEW_ALLOCATIONS);
+
+    RenderOutput output = accumulation.resolve();
+    expectCounts("Output copy", 0, 0, [&] {
+        RenderOutput outputCopy = output;
+        outputCopy.sampleCount = 0;
+    });
+
+    expectCounts("Save EXR", 0, 0, [&] {
+        writeEXR(folder / "color.exr", output.color);
+        writeEXR(folder / "variance.exr", output.variance);
+    });
+
+    Texture<u8vec3> colorSRGB;
+    expectCounts("Tone mapping", 1, 0, [&] { colorSRGB = hdrToSRGB(output.color); });
+    expectCounts("Save BMP", 0, 0, [&] { writeBMP(folder / "color.bmp", colorSRGB); });
+
+    // Tone mapped and denoised images are new textures, the resolved channels are only read
+    expectCounts("Save output", -1, 0, [&] { saveOutput(output, renderer.m_outputChannels, folder); });
+
+    std::filesystem::remove_all(folder);
+
+    LOG(passed ? "Texture sharing test passed" : "Texture sharing test FAILED");
+    return passed;
+}
+
+#else
+
+bool testTextureSharing(const std::function<std::pair<Ref<World>, Ref<Camera>>()>& loadScene,
+                        const std::function<Renderer()>& createRenderer,
+                        const std::function<void(const AccumulationBuffer&, const std::filesystem::path&)>& savePreview,
+                        const std::function<void(const RenderOutput&, u32, const std::filesystem::path&)>& saveOutput) {
+    LOG("Texture sharing test needs a build with TEXTURE_TEST");
+    return false;
+}
+
+#endif
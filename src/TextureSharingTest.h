@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Renderer.h"
+
+/*
+ * @brief Checks by counting texel allocations and copies that copying textures and passing render outputs through
+ *        the sample callback, postprocessing and IO doesn't copy the texels. Needs a build with TEXTURE_TEST.
+ *
+ * A frame is rendered with the renderer and preview task of the render mode. Only the texels of textures are counted,
+ * the conversions into the buffers of the libraries, like the planar channels of writeEXR and the denoiser's device
+ * buffers, are not.
+ *
+ * @param loadScene Loads the scene of the frame.
+ * @param createRenderer Creates the renderer of the render mode, the test only shrinks its image and sample count.
+ * @param savePreview Task of the preview worker of the render mode.
+ * @param saveOutput Saves the final output of the render mode.
+ * @return Whether all the checks passed.
+ */
+bool testTextureSharing(const std::function<std::pair<Ref<World>, Ref<Camera>>()>& loadScene,
+                        const std::function<Renderer()>& createRenderer,
+                        const std::function<void(const AccumulationBuffer&, const std::filesystem::path&)>& savePreview,
+                        const std::function<void(const RenderOutput&, u32, const std::filesystem::path&)>& saveOutput);
@@ -0,0 +1,36 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(u32 threadCount) {
+    for (u32 i = 0; i < threadCount; i++)
+        m_workers.emplace_back(&ThreadPool::run, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_condition.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+void ThreadPool::run() {
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this] { return !m_tasks.empty() || m_stop; });
+
+            if (m_tasks.empty())
+                return;  // Stopped with nothing left to run
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+
+        task();  // Exceptions are stored in the future by the packaged task
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+
+/*
+ * @brief Fixed set of worker threads running submitted tasks in FIFO order.
+ *
+ * Tasks shouldn't wait for other queued tasks, with every worker waiting nothing would run them.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(u32 threadCount = std::max(std::thread::hardware_concurrency(), 1U));
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /*
+     * @brief Finishes the queued tasks and joins the workers.
+     */
+    ~ThreadPool();
+
+    /*
+     * @brief Queues a task.
+     * @return Future of the task result, exceptions thrown by the task are rethrown by get.
+     */
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& task) {
+        auto packagedTask = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(task));
+        auto future = packagedTask->get_future();
+
+        {
+            std::lock_guard lock(m_mutex);
+            m_tasks.emplace([packagedTask] { (*packagedTask)(); });
+        }
+
+        m_condition.notify_one();
+        return future;
+    }
+
+    inline u32 threadCount() const { return (u32)m_workers.size(); }
+
+private:
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop = false;
+
+    void run();
+};
@@ -68,9 +68,12 @@ public:
         return glm::normalize(vec3(modelMatrix() * vec4(VEC_RIGHT, 0.0f)));
     }
 
-    void updateMatrices() {
+    /*
+     * @return True if the matrices were outdated and got recomputed.
+     */
+    bool updateMatrices() {
         if (m_cacheValid)
-            return;
+            return false;
 
         m_modelMatrix = mat4(1.0f);
         m_modelMatrix = glm::translate(m_modelMatrix, m_position);
@@ -79,6 +82,7 @@ public:
         m_modelMatrixInverse = glm::inverse(m_modelMatrix);
 
         m_cacheValid = true;
+        return true;
     }
 
 private:
@@ -28,6 +28,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/component_wise.hpp>
 #include <glm/gtx/quaternion.hpp>
 
 constexpr f64 E = 2.7182818284590452353602874713526624977572470936999595749669676277240766303535475945713821785251664274;
@@ -169,6 +170,14 @@ MATH_FUNC_QUALIFIER f32 reflectance(f32 cosine, f32 refractionRatio) {
     return r0 + (1 - r0) * static_cast<f32>(std::pow((1 - cosine), 5));
 }
 
+/*
+ * @param color Linear RGB color
+ * @return Relative luminance of the color (Rec. 709)
+ */
+MATH_CONSTEXPR MATH_FUNC_QUALIFIER f32 luminance(const vec3& color) {
+    return glm::dot(color, vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
 // a closed interval [min, max]
 template <typename T>
 struct Interval {
@@ -177,6 +177,31 @@ inline T randomNormal() {
     return z0;
 }
 
+// Warping of uniform samples
+
+/*
+ * @param u A uniform sample in [0, 1)^2.
+ * @return A vec3 on a unit sphere.
+ */
+inline vec3 squareToUnitSphere(const vec2& u) {
+    // https://pbr-book.org/3ed-2018/Monte_Carlo_Integration/2D_Sampling_with_Multidimensional_Transformations
+    f32 z = 1 - 2 * u[0];
+    f32 r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    f32 phi = 2 * PI * u[1];
+    return vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+/*
+ * @param u A uniform sample in [0, 1)^2.
+ * @return A vec2 in a unit disk around 0.
+ */
+inline vec2 squareToUnitDisk(const vec2& u) {
+    // https://pbr-book.org/3ed-2018/Monte_Carlo_Integration/2D_Sampling_with_Multidimensional_Transformations
+    f32 r = std::sqrt(u[0]);
+    f32 theta = 2 * PI * u[1];
+    return vec2(r * std::cos(theta), r * std::sin(theta));
+}
+
 // Random vectors
 
 /*
@@ -224,13 +249,7 @@ inline glm::vec<L, T> randomUnitVec() {
  */
 template <>
 inline glm::vec<3, f32> randomUnitVec() {
-    // https://pbr-book.org/3ed-2018/Monte_Carlo_Integration/2D_Sampling_with_Multidimensional_Transformations
-    vec2 u = randomVec<2>();
-
-    f32 z = 1 - 2 * u[0];
-    f32 r = std::sqrt(std::max(0.0f, 1.0f - z * z));
-    f32 phi = 2 * PI * u[1];
-    return vec3(r * std::cos(phi), r * std::sin(phi), z);
+    return squareToUnitSphere(randomVec<2>());
 }
 
 /*
@@ -254,12 +273,7 @@ inline vec3 randomVec3OnHemisphere(const vec3& normal) {
  * @note Uses RANDOM_GENERATOR internally.
  */
 inline vec2 randomVec2InUnitDisk() {
-    // https://pbr-book.org/3ed-2018/Monte_Carlo_Integration/2D_Sampling_with_Multidimensional_Transformations
-    vec2 u = randomVec<2>();
-
-    f32 r = std::sqrt(u[0]);
-    f32 theta = 2 * PI * u[1];
-    return vec2(r * std::cos(theta), r * std::sin(theta));
+    return squareToUnitDisk(randomVec<2>());
 }
 
 /*
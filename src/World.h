@@ -1,5 +1,7 @@
 #pragma once
 
+#include <mutex>
+
 #include "Hittables/HittableGroup.h"
 #include "Material.h"
 
@@ -11,4 +13,31 @@ struct World {
         .emissionIntensity = 1.0f,
         .scatterFunction = environmentScatter,
     });
+
+    /*
+     * @brief Prepares the hierarchy for rendering (builds BVHs, updates transforms).
+     * @return True if the geometry changed since the last frame.
+     *
+     * Only the first call after a change does any work, so frames sharing the world can be rendered concurrently.
+     */
+    bool frameBegin() {
+        std::scoped_lock lock(m_frameBeginMutex);
+        if (!m_dirty)
+            return false;
+
+        m_dirty = false;
+        return hierarchy.frameBegin();
+    }
+
+    /*
+     * @brief Marks the hierarchy as changed, the next frame prepares it again.
+     */
+    void markDirty() {
+        std::scoped_lock lock(m_frameBeginMutex);
+        m_dirty = true;
+    }
+
+private:
+    std::mutex m_frameBeginMutex;
+    bool m_dirty = true;
 };
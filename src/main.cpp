@@ -1,17 +1,78 @@
+#include <omp.h>
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "GeometryRegistry.h"
 #include "Hittables/Disc.h"
 #include "Hittables/Plane.h"
 #include "Hittables/Sphere.h"
 #include "Hittables/TransformedInstance.h"
+#include "IO/AccumulationIO.h"
 #include "IO/MeshIO.h"
 #include "IO/TextureIO.h"
+#include "InteractiveSession.h"
 #include "Postprocessing.h"
+#include "RenderJob.h"
+#include "RenderService.h"
 #include "Renderer.h"
+#include "SnapshotWorker.h"
+#include "TextureCache.h"
+#include "TextureRegistry.h"
+#include "TextureBenchmark.h"
+#include "TextureSharingTest.h"
+#include "ThreadPool.h"
 
 constexpr bool ENABLE_PREVIEW = true;
 constexpr bool DENOISE_PREVIEW = true;
 constexpr auto PROGRESS_VIEW_UPDATE_INTERVAL = std::chrono::seconds(5);
+constexpr auto CHECKPOINT_INTERVAL = std::chrono::seconds(60);
 const std::filesystem::path OUTPUT_FOLDER = "output";
 
+constexpr f32 GAMMA = 2.2f;
+
+TextureCache TEXTURE_CACHE;  // Shared by all the scenes, has to outlive them
+TextureRegistry TEXTURE_REGISTRY(&TEXTURE_CACHE);
+VertexFormat VERTEX_FORMAT = VertexFormat::Full;  // Vertex attribute storage of the loaded meshes
+PageCache GEOMETRY_PAGE_CACHE;  // Pages out of core geometry, has to outlive the scenes
+PageCache* OUT_OF_CORE_GEOMETRY = nullptr;  // GEOMETRY_PAGE_CACHE once out of core geometry is enabled
+GeometryRegistry GEOMETRY_REGISTRY;  // Shares the geometry of repeated meshes, also between scenes of a batch
+
+// Decodes textures and builds BVHs while the scenes are set up, started by the first scene load so the other modes
+// don't spawn its threads. Destroyed before the registries above, its tasks finish while they still exist.
+ThreadPool& assetPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+OBJLoadOptions objLoadOptions() {
+    return {
+        .textureRegistry = &TEXTURE_REGISTRY,
+        .pool = &assetPool(),
+        .vertexFormat = VERTEX_FORMAT,
+        .geometryPageCache = OUT_OF_CORE_GEOMETRY,
+        .geometryRegistry = &GEOMETRY_REGISTRY,
+    };
+}
+
+// Page faults and residency of the out of core geometry since the last call
+std::string geometryPagingReport() {
+    static PageCache::Stats lastStats;
+    auto stats = GEOMETRY_PAGE_CACHE.stats();
+    auto report = std::format("Geometry pages: {} faults, {} evictions, {:.1f}/{:.1f} MB resident, {:.1f} MB pinned",
+                              stats.misses - lastStats.misses, stats.evictions - lastStats.evictions,
+                              stats.residentBytes / (1024.0 * 1024.0), stats.mappedBytes / (1024.0 * 1024.0), stats.pinnedBytes / (1024.0 * 1024.0));
+    lastStats = stats;
+    return report;
+}
+
+// Loads on the asset pool, so the scene setup isn't blocked by the decode
+std::future<Ref<EmissionTexture>> loadEnvironmentAsync() {
+    return assetPool().submit([] { return TEXTURE_REGISTRY.load<vec3, HalfTexel<3>>("resources/evening_field_1k.exr"); });
+}
+
 constexpr u32 DENOISE_CHANNELS = (u32)Renderer::OutputChannel::Color | (u32)Renderer::OutputChannel::Albedo | (u32)Renderer::OutputChannel::Normal;
 
 std::pair<Ref<World>, Ref<Camera>> sphereScene() {
@@ -25,7 +86,7 @@ std::pair<Ref<World>, Ref<Camera>> sphereScene() {
     camera->m_defocusAngle = 3.0f;
     camera->m_focusDistance = glm::length(camera->m_position - camera->m_lookAt);
 
-    world->environmentMaterial->emissionTexture = makeRef<Texture<vec3>>(loadTexture<vec3>("resources/evening_field_1k.exr"));
+    world->environmentMaterial->emissionTexture = TEXTURE_REGISTRY.load<vec3, HalfTexel<3>>("resources/evening_field_1k.exr");
 
     // world
     auto groundMaterial = makeRef<Material>();
@@ -71,7 +132,10 @@ std::pair<Ref<World>, Ref<Camera>> randomSphereScene() {
     camera->m_defocusAngle = 0.6f;
     camera->m_focusDistance = 10.0f;
 
-    world->environmentMaterial->emissionTexture = makeRef<Texture<vec3>>(loadTexture<vec3>("resources/evening_field_1k.exr"));
+    world->environmentMaterial->emissionTexture = TEXTURE_REGISTRY.load<vec3, HalfTexel<3>>("resources/evening_field_1k.exr");
+
+    // Fixed seed, so every process of a partitioned render builds the same scene
+    RANDOM_GENERATOR = Xoshiro256SS(1);
 
     // world
     auto groundMaterial = makeRef<Material>();
@@ -155,16 +219,20 @@ std::pair<Ref<World>, Ref<Camera>> teapotDragonScene() {
     camera->m_lookAt = vec3(0, 0, 0);
     camera->m_fov = 48.0f;
 
-    world->environmentMaterial->emissionTexture = makeRef<Texture<vec3>>(loadTexture<vec3>("resources/evening_field_1k.exr"));
+    auto environmentTexture = loadEnvironmentAsync();
 
     // world
     auto groundMaterial = makeRef<Material>();
     *groundMaterial = {
-        .albedoTexture = makeRef<Texture<vec3>>(loadTexture<vec3>("resources/uv_test.png")),
+        .albedoTexture = TEXTURE_REGISTRY.load<vec3, u8vec3>("resources/uv_test.png"),
     };
     world->hierarchy.add(makeRef<Disc>(Transform(vec3(0.0f, -0.15f, -0.1f)), groundMaterial));
 
-    auto teapotModel = makeRef<Model>(loadOBJ("resources/teapot.obj"));
+    // Both models are parsed at once, not on the pool, their loads wait for textures and BVHs on it
+    auto teapotLoad = std::async(std::launch::async, [] { return loadOBJ("resources/teapot.obj", objLoadOptions()); });
+    auto dragonLoad = std::async(std::launch::async, [] { return loadOBJ("resources/dragon.obj", objLoadOptions()); });
+
+    auto teapotModel = makeRef<Model>(teapotLoad.get());
     *teapotModel->m_mesh.materials[0] = {
         .ir = 1.5f,
         .scatterFunction = dielectricScatter,
@@ -172,7 +240,7 @@ std::pair<Ref<World>, Ref<Camera>> teapotDragonScene() {
     auto teapot = makeRef<TransformedInstance>(teapotModel, Transform(vec3(-0.12, -0.1, 0.3), glm::radians(vec3(0, -20, 0)), vec3(1.5)));
     world->hierarchy.add(teapot);
 
-    auto dragonModel = makeRef<Model>(loadOBJ("resources/dragon.obj"));
+    auto dragonModel = makeRef<Model>(dragonLoad.get());
     *dragonModel->m_mesh.materials[0] = {
         .albedo = vec3(0.5, 0.6, 0.8),
     };
@@ -191,6 +259,8 @@ std::pair<Ref<World>, Ref<Camera>> teapotDragonScene() {
     camera->m_defocusAngle = 0.6f;
     camera->m_focusDistance = glm::distance(camera->m_position, sphere->m_center) - 0.1f;
 
+    world->environmentMaterial->emissionTexture = environmentTexture.get();
+
     return {world, camera};
 }
 
@@ -203,7 +273,7 @@ std::pair<Ref<World>, Ref<Camera>> reimuScene() {
     camera->m_lookAt = vec3(0, 0, 0);
     camera->m_fov = 48.0f;
 
-    world->environmentMaterial->emissionTexture = makeRef<Texture<vec3>>(loadTexture<vec3>("resources/evening_field_1k.exr"));
+    auto environmentTexture = loadEnvironmentAsync();
 
     // world
     auto groundMaterial = makeRef<Material>();
@@ -212,11 +282,13 @@ std::pair<Ref<World>, Ref<Camera>> reimuScene() {
     };
     world->hierarchy.add(makeRef<Plane>(Transform(vec3(0.0f, -0.43f, 0.3f), glm::radians(vec3(0, -45, 0)), vec3(2.0f)), groundMaterial));
 
-    auto reimuModel = makeRef<Model>(loadOBJ("resources/reimu/reimu.obj"));
+    auto reimuModel = makeRef<Model>(loadOBJ("resources/reimu/reimu.obj", objLoadOptions()));
     auto reimu = makeRef<TransformedInstance>(reimuModel, Transform(vec3(0.5, 0.15, 0.5), glm::radians(vec3(0, -90, 0)), vec3(1.0 / 20.0)));
 
     world->hierarchy.add(reimu);
 
+    world->environmentMaterial->emissionTexture = environmentTexture.get();
+
     return {world, camera};
 }
 
@@ -229,10 +301,10 @@ std::pair<Ref<World>, Ref<Camera>> sponzaScene() {
     camera->m_lookAt = vec3(6, 1.7, 0);
     camera->m_fov = 50.0f;
 
-    world->environmentMaterial->emissionTexture = makeRef<Texture<vec3>>(loadTexture<vec3>("resources/evening_field_1k.exr"));
+    auto environmentTexture = loadEnvironmentAsync();
 
     // world
-    auto sponzaModel = makeRef<Model>(loadOBJ("resources/sponza/sponza.obj"));
+    auto sponzaModel = makeRef<Model>(loadOBJ("resources/sponza/sponza.obj", objLoadOptions()));
     auto sponza = makeRef<TransformedInstance>(sponzaModel, Transform(vec3(0.0f), vec3(0.0f), vec3(1.0 / 100.0)));
     world->hierarchy.add(sponza);
 
@@ -245,6 +317,8 @@ std::pair<Ref<World>, Ref<Camera>> sponzaScene() {
     world->hierarchy.add(makeRef<Sphere>(vec3(-4, 2.5, 1), 0.3f, lightMaterial));
     world->hierarchy.add(makeRef<Sphere>(vec3(4, 0.5, -1.5), 0.3f, lightMaterial));
 
+    world->environmentMaterial->emissionTexture = environmentTexture.get();
+
     return {world, camera};
 }
 
@@ -257,99 +331,695 @@ std::pair<Ref<World>, Ref<Camera>> normalTestScene() {
     camera->m_lookAt = vec3(0, 0, 0);
     camera->m_fov = 48.0f;
 
-    world->environmentMaterial->emissionTexture = makeRef<Texture<vec3>>(loadTexture<vec3>("resources/evening_field_1k.exr"));
+    auto environmentTexture = loadEnvironmentAsync();
 
     // world
-    auto cubeModel = makeRef<Model>(loadOBJ("resources/normal_test/normal_test.obj"));
-    cubeModel->m_mesh.materials[0]->albedoTexture = makeRef<Texture<vec3>>(loadTexture<vec3>("resources/uv_test.png"));
+    auto cubeModel = makeRef<Model>(loadOBJ("resources/normal_test/normal_test.obj", objLoadOptions()));
+    cubeModel->m_mesh.materials[0]->albedoTexture = TEXTURE_REGISTRY.load<vec3, u8vec3>("resources/uv_test.png");
     auto cube = makeRef<TransformedInstance>(cubeModel, Transform(vec3(0.0f), glm::radians(vec3(30, -30, 0)), vec3(1.0 / 2.0)));
 
     world->hierarchy.add(cube);
 
+    world->environmentMaterial->emissionTexture = environmentTexture.get();
+
     return {world, camera};
 }
 
-void render() {
-    // Setup renderer
+const std::function<std::pair<Ref<World>, Ref<Camera>>()> SCENES[] = {
+    /* 0 */ sphereScene,
+    /* 1 */ randomSphereScene,
+    /* 2 */ teapotDragonScene,
+    /* 3 */ reimuScene,
+    /* 4 */ sponzaScene,
+    /* 5 */ normalTestScene,
+};
+
+std::pair<Ref<World>, Ref<Camera>> loadScene(u32 sceneIndex) {
+    if (sceneIndex >= std::size(SCENES))
+        throw std::runtime_error(std::format("Invalid scene index {}", sceneIndex));
+
+    return SCENES[sceneIndex]();
+}
+
+Renderer createRenderer() {
     Renderer renderer;
     renderer.m_imageSize = uvec2(640, 480);
     renderer.m_samples = 128;
     renderer.m_maxBounces = 8;
-    renderer.m_outputChannels = (u32)Renderer::OutputChannel::Color | (u32)Renderer::OutputChannel::Albedo | (u32)Renderer::OutputChannel::Normal;
-    f32 gamma = 2.2f;
+    renderer.m_samplerType = SamplerType::Sobol;
+    renderer.m_seed = 0;
+    renderer.m_russianRoulette = true;
+    renderer.m_splitCount = 1;
+    renderer.m_outputChannels = (u32)Renderer::OutputChannel::Color | (u32)Renderer::OutputChannel::Albedo | (u32)Renderer::OutputChannel::Normal | (u32)Renderer::OutputChannel::Variance;
+    return renderer;
+}
+
+// Task of the preview worker, the preview is denoised if the buffer has the denoising channels
+void savePreview(const AccumulationBuffer& accumulation, const std::filesystem::path& folder = OUTPUT_FOLDER) {
+    bool canBeDenoised = (accumulation.channels() & DENOISE_CHANNELS) == DENOISE_CHANNELS;
+    auto output = accumulation.resolve(DENOISE_CHANNELS, true);
+    auto preview = DENOISE_PREVIEW && canBeDenoised ? denoiseFrameOIDN(output.color, output.albedo, output.normal, false) : output.color;
+    auto previewSRGB = hdrToSRGB(preview, GAMMA);
+    writeBMP(folder / "preview.bmp", previewSRGB);
+}
+
+void saveOutput(const Renderer::Output& output, u32 channels, const std::filesystem::path& folder = OUTPUT_FOLDER) {
+    if (!std::filesystem::exists(folder))
+        std::filesystem::create_directories(folder);
+
+    bool canBeDenoised = (channels & DENOISE_CHANNELS) == DENOISE_CHANNELS;
+
+    if (channels & (u32)Renderer::OutputChannel::Color) {
+        writeEXR(folder / "color.exr", output.color);
+        writeBMP(folder / "color.bmp", hdrToSRGB(output.color, GAMMA));
+    }
+    if (canBeDenoised) {
+        Texture<vec3> denoisedColor = denoiseFrameOIDN(output.color, output.albedo, output.normal);
+        writeEXR(folder / "denoised.exr", denoisedColor);
+        writeBMP(folder / "denoised.bmp", hdrToSRGB(denoisedColor, GAMMA));
+    }
+    if (channels & (u32)Renderer::OutputChannel::Depth)
+        writeEXR(folder / "depth.exr", output.depth);
+    if (channels & (u32)Renderer::OutputChannel::Normal)
+        writeEXR(folder / "normal.exr", output.normal);
+    if (channels & (u32)Renderer::OutputChannel::Albedo)
+        writeEXR(folder / "albedo.exr", output.albedo);
+    if (channels & (u32)Renderer::OutputChannel::Emission)
+        writeEXR(folder / "emission.exr", output.emission);
+    if (channels & (u32)Renderer::OutputChannel::Variance)
+        writeEXR(folder / "variance.exr", output.variance);
+#ifdef BVH_TEST
+    if (channels & (u32)Renderer::OutputChannel::AABBTestCount)
+        writeEXR(folder / "aabb-test-count.exr", output.aabbTestCount);
+    if (channels & (u32)Renderer::OutputChannel::TriangleTestCount)
+        writeEXR(folder / "triangle-test-count.exr", output.triangleTestCount);
+#endif
+
+    std::ofstream metadata(folder / "metadata.txt");
+    metadata << std::format("samples {}\nestimated-error {}\nrender-time {:.3f}\n", output.sampleCount, output.estimatedError, output.renderTime.count() / 1e6);
+}
+
+/*
+ * @brief Replaces the pixels outside of a rendered region by the previous output in the folder, so a region render only fixes a part of the frame.
+ */
+void mergeWithPreviousOutput(Renderer::Output& output, u32 channels, const std::filesystem::path& folder, uvec2 regionOffset, uvec2 regionSize) {
+    uvec2 regionMax = regionOffset + regionSize;
+
+    auto merge = [&]<typename T>(Texture<T>& texture, Renderer::OutputChannel channel, const std::string& fileName) {
+        auto filePath = folder / fileName;
+        if (!(channels & (u32)channel) || !std::filesystem::exists(filePath))
+            return;
+
+        auto previous = loadTexture<T>(filePath, false, false);
+        if (previous.size() != texture.size()) {
+            LOG(std::format("{} differs in size, the region is saved alone", filePath.string()));
+            return;
+        }
+
+        texture.makeUnique();
+        for (u32 y = 0; y < texture.size().y; y++) {
+            for (u32 x = 0; x < texture.size().x; x++) {
+                uvec2 pixel = uvec2(x, y);
+                if (glm::any(pixel < regionOffset) || glm::any(pixel >= regionMax))
+                    texture[pixel] = previous[pixel];
+            }
+        }
+    };
+
+    merge(output.color, Renderer::OutputChannel::Color, "color.exr");
+    merge(output.depth, Renderer::OutputChannel::Depth, "depth.exr");
+    merge(output.normal, Renderer::OutputChannel::Normal, "normal.exr");
+    merge(output.albedo, Renderer::OutputChannel::Albedo, "albedo.exr");
+    merge(output.emission, Renderer::OutputChannel::Emission, "emission.exr");
+    merge(output.variance, Renderer::OutputChannel::Variance, "variance.exr");
+}
+
+struct RenderOptions {
+    u32 sceneIndex = 2;
+    u32 partitionIndex = 0;
+    u32 partitionCount = 1;
+    std::optional<u32> samples;        // Overrides the sample count, can extend a resumed render
+    std::filesystem::path resumeFrom;  // Checkpoint to continue from
+    std::chrono::milliseconds timeBudget = std::chrono::milliseconds(0);
+    f32 targetError = 0;
+    uvec2 regionOffset = uvec2(0);
+    uvec2 regionSize = uvec2(0);  // Zero renders the whole frame
+    u32 progressiveLevels = 0;
+    std::optional<size_t> textureBudget;  // Bytes of resident texture cache pages
+};
+
+void render(const RenderOptions& options) {
+    // Setup renderer
+    Renderer renderer = createRenderer();
+    renderer.m_partitionIndex = options.partitionIndex;
+    renderer.m_partitionCount = options.partitionCount;
+    renderer.m_timeBudget = options.timeBudget;
+    renderer.m_targetError = options.targetError;
+    renderer.m_regionOffset = options.regionOffset;
+    renderer.m_regionSize = options.regionSize;
+    renderer.m_progressiveLevels = options.progressiveLevels;
+
+    // Resume
+    AccumulationBuffer resumeFrom;
+    u32 resumeSampleCount = 0;
+    if (!options.resumeFrom.empty()) {
+        AccumulationInfo resumeInfo;
+        std::tie(resumeFrom, resumeInfo) = loadAccumulation(options.resumeFrom);
+
+        // Continue the same sample sequence
+        renderer.m_seed = resumeInfo.seed;
+        renderer.m_samplerType = resumeInfo.samplerType;
+        renderer.m_samples = resumeInfo.totalSamples;
+        renderer.m_partitionIndex = resumeInfo.partitionIndex;
+        renderer.m_partitionCount = resumeInfo.partitionCount;
+        renderer.m_imageSize = resumeFrom.size();
+        renderer.m_outputChannels = resumeFrom.channels();
+        resumeSampleCount = resumeInfo.completedSamples;
+    }
+
+    if (options.samples)
+        renderer.m_samples = *options.samples;
+
+    u32 partitionIndex = renderer.m_partitionIndex;
+    u32 partitionCount = renderer.m_partitionCount;
 
     bool canBeDenoised = (renderer.m_outputChannels & DENOISE_CHANNELS) == DENOISE_CHANNELS;
     if (DENOISE_PREVIEW && !canBeDenoised)
         LOG("Denoising preview is disabled because the output channels do not include color, albedo, or normal");
 
+    // Previews are denoised and saved on a background thread while sampling continues
+    SnapshotWorker previewWorker([](const AccumulationBuffer& accumulation, u32 sample) { savePreview(accumulation); });
+
+    u32 sampleCount = renderer.partitionSampleCount();
+    AccumulationInfo checkpointInfo = {
+        .seed = renderer.m_seed,
+        .samplerType = renderer.m_samplerType,
+        .totalSamples = renderer.m_samples,
+        .partitionIndex = partitionIndex,
+        .partitionCount = partitionCount,
+    };
+
+    // Partial renders are merged later with --merge, their checkpoint is the partial file itself
+    std::filesystem::path checkpointPath = OUTPUT_FOLDER / (partitionCount > 1 ? std::format("partial-{}-of-{}.lwacc", partitionIndex + 1, partitionCount) : "checkpoint.lwacc");
+
+    // Checkpoints are written on a background thread, through a temporary file so a crash never leaves a broken one
+    SnapshotWorker checkpointWorker([&](const AccumulationBuffer& accumulation, u32 sample) {
+        AccumulationInfo info = checkpointInfo;
+        info.completedSamples = sample;
+
+        auto temporaryPath = std::filesystem::path(checkpointPath).concat(".tmp");
+        writeAccumulation(temporaryPath, accumulation, info);
+        std::filesystem::rename(temporaryPath, checkpointPath);
+    });
+
+    renderer.m_levelCallback = [&](const AccumulationBuffer& accumulation, u32 stride) {
+        LOG(std::format("Progressive level 1/{} done", stride));
+
+        if (ENABLE_PREVIEW && accumulation.channels() & (u32)Renderer::OutputChannel::Color)
+            previewWorker.publish(accumulation, 0);
+    };
+
     auto previewNextUpdate = std::chrono::high_resolution_clock::now();
-    renderer.m_sampleCallback = [&](const Renderer::Output& output, u32 sample) {
-        LOG(std::format("{}/{} samples done ({:.1f}%)", sample, renderer.m_samples, sample * 100.0f / renderer.m_samples));
+    auto checkpointNextUpdate = std::chrono::high_resolution_clock::now() + CHECKPOINT_INTERVAL;
+    auto setupStart = std::chrono::high_resolution_clock::now();
+    bool isFirstSample = true;
+    renderer.m_sampleCallback = [&](const AccumulationBuffer& accumulation, u32 sample) {
+        if (isFirstSample) {
+            auto firstSampleTime = std::chrono::high_resolution_clock::now() - setupStart;
+            LOG(std::format("Time to first sample: {:.2f}s", std::chrono::duration_cast<std::chrono::milliseconds>(firstSampleTime).count() / 1000.0));
+            isFirstSample = false;
+        }
 
-        if (ENABLE_PREVIEW && output.color.size() != uvec2(0)) {
-            auto currentTime = std::chrono::high_resolution_clock::now();
-            if (previewNextUpdate <= currentTime || sample == renderer.m_samples) {
-                auto preview = DENOISE_PREVIEW && canBeDenoised ? denoiseFrameOIDN(output.color, output.albedo, output.normal, false) : output.color;
-                auto previewSRGB = hdrToSRGB(preview, gamma);
-                writeBMP(OUTPUT_FOLDER / "preview.bmp", previewSRGB);
+        // With a budget the final sample count is only predicted
+        u32 expectedSampleCount = renderer.predictSampleCount();
+        LOG(std::format("{}/{} samples done ({:.1f}%), estimated error {:.5f}", sample, expectedSampleCount, sample * 100.0f / expectedSampleCount, renderer.stats().estimatedError));
+        if (OUT_OF_CORE_GEOMETRY)
+            LOG(geometryPagingReport());
 
-                previewNextUpdate = currentTime + PROGRESS_VIEW_UPDATE_INTERVAL;
-            }
+        auto currentTime = std::chrono::high_resolution_clock::now();
+        if (ENABLE_PREVIEW && accumulation.channels() & (u32)Renderer::OutputChannel::Color && previewNextUpdate <= currentTime) {
+            previewWorker.publish(accumulation, sample);
+            previewNextUpdate = currentTime + PROGRESS_VIEW_UPDATE_INTERVAL;
         }
-    };
 
-    // Setup scene
-    std::function<std::pair<Ref<World>, Ref<Camera>>()> scenes[] = {
-        /* 0 */ sphereScene,
-        /* 1 */ randomSphereScene,
-        /* 2 */ teapotDragonScene,
-        /* 3 */ reimuScene,
-        /* 4 */ sponzaScene,
-        /* 5 */ normalTestScene,
+        if (checkpointNextUpdate <= currentTime) {
+            checkpointWorker.publish(accumulation, sample);
+            checkpointNextUpdate = currentTime + CHECKPOINT_INTERVAL;
+        }
     };
-    u32 sceneIndex = 2;
 
-    auto [world, camera] = scenes[sceneIndex]();
+    // Setup scene
+    if (options.textureBudget) {
+        TEXTURE_CACHE.m_memoryBudget = *options.textureBudget;
+        TEXTURE_CACHE.m_pageTexels = true;
+    }
+    setupStart = std::chrono::high_resolution_clock::now();
+    auto [world, camera] = loadScene(options.sceneIndex);
+    LOG(std::format("Scene loaded in {:.2f}s", std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - setupStart).count() / 1000.0));
 
     // Render
     if (!std::filesystem::exists(OUTPUT_FOLDER))
         std::filesystem::create_directory(OUTPUT_FOLDER);
 
-    LOG(std::format("Rendering image {}x{}", renderer.m_imageSize.x, renderer.m_imageSize.y));
+    LOG(std::format("Rendering image {}x{}, partition {}/{}", renderer.m_imageSize.x, renderer.m_imageSize.y, partitionIndex + 1, partitionCount));
+
+    if (resumeSampleCount != 0)
+        LOG(std::format("Resuming from {} with {}/{} samples done", options.resumeFrom.string(), resumeSampleCount, sampleCount));
 
     auto start = std::chrono::high_resolution_clock::now();
-    Renderer::Output output = renderer.renderFrame(world, camera);
+    AccumulationBuffer accumulation = renderer.accumulateFrame(world, camera, std::move(resumeFrom), resumeSampleCount);
     auto stop = std::chrono::high_resolution_clock::now();
 
     LOG(std::format("Time taken: {:.2f}s", std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() / 1000.0));
 
+    const auto& stats = renderer.stats();
+    LOG(std::format("Rays traced: {} ({:.2f} Mrays/s)", stats.rayCount, stats.rayCount / (f64)stats.renderTime.count()));
+    LOG(std::format("Samples: {}/{}, estimated error: {:.5f}", stats.sampleCount, sampleCount, stats.estimatedError));
+
+    if (TEXTURE_CACHE.m_pageTexels) {
+        auto textureStats = TEXTURE_CACHE.stats();
+        LOG(std::format("Texture cache: {} hits, {} misses, {} evictions, {:.1f}/{:.1f} MB resident", textureStats.hits, textureStats.misses, textureStats.evictions,
+                        textureStats.residentBytes / (1024.0 * 1024.0), textureStats.mappedBytes / (1024.0 * 1024.0)));
+    }
+
+    auto registryStats = TEXTURE_REGISTRY.stats();
+    LOG(std::format("Texture registry: {} loaded, {} shared, {:.1f} MB saved", registryStats.loadCount, registryStats.sharedCount, registryStats.bytesSaved / (1024.0 * 1024.0)));
+
+    auto geometryRegistryStats = GEOMETRY_REGISTRY.stats();
+    LOG(std::format("Geometry registry: {} loaded, {} shared, {:.1f} MB saved", geometryRegistryStats.loadCount, geometryRegistryStats.sharedCount, geometryRegistryStats.bytesSaved / (1024.0 * 1024.0)));
+
+    // The final checkpoint allows extending the render with more samples later
+    if (ENABLE_PREVIEW && accumulation.channels() & (u32)Renderer::OutputChannel::Color)
+        previewWorker.publish(accumulation, stats.sampleCount);
+    checkpointWorker.publish(accumulation, stats.sampleCount);
+
+    previewWorker.flush();  // The denoiser isn't thread safe
+    checkpointWorker.flush();
+
     // Save output
-    if (renderer.m_outputChannels & (u32)Renderer::OutputChannel::Color) {
-        writeEXR(OUTPUT_FOLDER / "color.exr", output.color);
-        writeBMP(OUTPUT_FOLDER / "color.bmp", hdrToSRGB(output.color, gamma));
+    if (partitionCount > 1)
+        return;  // Only the partial file is saved
+
+    auto output = accumulation.resolve();
+    output.renderTime = stats.renderTime;
+    output.sampleCount = stats.sampleCount;
+    output.estimatedError = stats.estimatedError;
+    if (renderer.m_regionSize != uvec2(0))
+        mergeWithPreviousOutput(output, renderer.m_outputChannels, OUTPUT_FOLDER, renderer.m_regionOffset, renderer.m_regionSize);
+    saveOutput(output, renderer.m_outputChannels);
+}
+
+void merge(const std::vector<std::filesystem::path>& filePaths) {
+    if (filePaths.empty())
+        throw std::runtime_error("No files to merge");
+
+    auto [accumulation, info] = loadAccumulation(filePaths[0]);
+    std::set<u32> partitions = {info.partitionIndex};
+
+    for (size_t i = 1; i < filePaths.size(); i++) {
+        auto [partial, partialInfo] = loadAccumulation(filePaths[i]);
+        if (partialInfo.seed != info.seed || partialInfo.samplerType != info.samplerType || partialInfo.totalSamples != info.totalSamples || partialInfo.partitionCount != info.partitionCount)
+            throw std::runtime_error(std::format("{} was rendered with different settings", filePaths[i].string()));
+
+        if (!partitions.insert(partialInfo.partitionIndex).second)
+            throw std::runtime_error(std::format("Partition {} is present more than once", partialInfo.partitionIndex + 1));
+
+        accumulation.merge(partial);
     }
-    if (canBeDenoised) {
-        Texture<vec3> denoisedColor = denoiseFrameOIDN(output.color, output.albedo, output.normal);
-        writeEXR(OUTPUT_FOLDER / "denoised.exr", denoisedColor);
-        writeBMP(OUTPUT_FOLDER / "denoised.bmp", hdrToSRGB(denoisedColor, gamma));
+
+    if (partitions.size() != info.partitionCount)
+        LOG(std::format("Merged {} of {} partitions, the result has less samples than the full frame", partitions.size(), info.partitionCount));
+
+    if (!std::filesystem::exists(OUTPUT_FOLDER))
+        std::filesystem::create_directory(OUTPUT_FOLDER);
+
+    auto output = accumulation.resolve();
+    output.sampleCount = accumulation.maxSampleCount();
+    output.estimatedError = accumulation.estimateError();
+    saveOutput(output, accumulation.channels());
+}
+
+/*
+ * @brief Loads batch jobs, one per line as in parseRenderJob, empty lines and lines starting with # are skipped.
+ */
+std::vector<RenderJob> loadBatchJobs(const std::filesystem::path& filePath) {
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        LOG(std::format("Failed to open {}", filePath.string()));
+        throw std::runtime_error("Failed to open batch file");
+    }
+
+    std::vector<RenderJob> jobs;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos || line.starts_with('#'))
+            continue;
+
+        jobs.push_back(parseRenderJob(line));
+    }
+
+    return jobs;
+}
+
+/*
+ * @brief Renders all jobs of a batch file, scenes are loaded and prepared once and shared by all of their jobs.
+ * @param concurrency Number of jobs rendered at the same time, the threads are split between them.
+ */
+void renderBatch(const std::filesystem::path& filePath, u32 concurrency) {
+    auto jobs = loadBatchJobs(filePath);
+    if (jobs.empty())
+        return;
+
+    auto batchStart = std::chrono::high_resolution_clock::now();
+
+    // Load every scene once and build its BVHs up front
+    std::map<u32, std::pair<Ref<World>, Ref<Camera>>> scenes;
+    for (const auto& job : jobs) {
+        if (scenes.contains(job.sceneIndex))
+            continue;
+
+        auto scene = loadScene(job.sceneIndex);
+        scene.first->frameBegin();
+        scenes[job.sceneIndex] = scene;
+    }
+
+    auto startupTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - batchStart);
+    LOG(std::format("Loaded {} scenes for {} jobs in {:.2f}s", scenes.size(), jobs.size(), startupTime.count() / 1000.0));
+
+    concurrency = std::clamp(concurrency, 1U, (u32)jobs.size());
+    i32 threadsPerJob = std::max(1, omp_get_max_threads() / (i32)concurrency);
+
+    std::atomic<size_t> nextJob = 0;
+    std::mutex saveMutex;  // The denoiser isn't thread safe
+    auto worker = [&]() {
+        omp_set_num_threads(threadsPerJob);
+
+        for (size_t i = nextJob++; i < jobs.size(); i = nextJob++) {
+            const auto& job = jobs[i];
+            const auto& [world, sceneCamera] = scenes.at(job.sceneIndex);
+
+            auto camera = makeRef<Camera>(*sceneCamera);
+            job.apply(*camera);
+
+            Renderer renderer = createRenderer();
+            job.apply(renderer);
+
+            auto output = renderer.renderFrame(world, camera);
+            LOG(std::format("Job {} ({}/{}) rendered in {:.2f}s, {} samples, estimated error {:.5f}", job.name, i + 1, jobs.size(), output.renderTime.count() / 1e6, output.sampleCount, output.estimatedError));
+
+            std::scoped_lock lock(saveMutex);
+            saveOutput(output, renderer.m_outputChannels, OUTPUT_FOLDER / job.name);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (u32 i = 0; i < concurrency; i++)
+        threads.emplace_back(worker);
+    for (auto& thread : threads)
+        thread.join();
+
+    auto totalTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - batchStart);
+    LOG(std::format("Batch of {} jobs done in {:.2f}s, startup {:.2f}s amortized to {:.2f}s per job",
+        jobs.size(), totalTime.count() / 1000.0, startupTime.count() / 1000.0, startupTime.count() / 1000.0 / jobs.size()));
+}
+
+// Transform of a top level hittable, nullptr if it has none
+Transform* findTransform(const Ref<IHittable>& hittable) {
+    if (auto instance = std::dynamic_pointer_cast<TransformedInstance>(hittable))
+        return &instance->m_transform;
+    if (auto plane = std::dynamic_pointer_cast<Plane>(hittable))
+        return &plane->m_transform;
+    if (auto disc = std::dynamic_pointer_cast<Disc>(hittable))
+        return &disc->m_transform;
+
+    return nullptr;
+}
+
+// First material of a hittable, nullptr if it has none
+Material* findMaterial(const Ref<IHittable>& hittable) {
+    if (auto instance = std::dynamic_pointer_cast<TransformedInstance>(hittable))
+        return findMaterial(instance->m_hittable);
+    if (auto model = std::dynamic_pointer_cast<Model>(hittable))
+        return model->m_mesh.materials.empty() ? nullptr : model->m_mesh.materials[0].get();
+    if (auto sphere = std::dynamic_pointer_cast<Sphere>(hittable))
+        return sphere->m_material.get();
+    if (auto plane = std::dynamic_pointer_cast<Plane>(hittable))
+        return plane->m_material.get();
+    if (auto disc = std::dynamic_pointer_cast<Disc>(hittable))
+        return disc->m_material.get();
+
+    return nullptr;
+}
+
+/*
+ * @brief Renders a scene progressively and applies edits read from stdin between frames.
+ *
+ * Commands:
+ *   orbit <degrees>                   Rotate the camera around its look at point
+ *   fov <degrees>                     Set the camera field of view
+ *   move <index> <x> <y> <z>          Move the top level hittable at index
+ *   albedo <index> <r> <g> <b>        Set the albedo of the first material of the top level hittable at index
+ *   quit
+ */
+void renderInteractive(u32 sceneIndex) {
+    auto [world, camera] = loadScene(sceneIndex);
+
+    Renderer renderer = createRenderer();
+    renderer.m_outputChannels = DENOISE_CHANNELS;
+
+    InteractiveSession session(renderer, world, camera);
+
+    // Every frame is shown, the worker drops the frames it can't keep up with
+    SnapshotWorker previewWorker([&](const AccumulationBuffer& accumulation, u32 sample) {
+        auto output = accumulation.resolve(DENOISE_CHANNELS, true);
+        auto preview = DENOISE_PREVIEW ? denoiseFrameOIDN(output.color, output.albedo, output.normal, false) : output.color;
+        writeBMP(OUTPUT_FOLDER / "preview.bmp", hdrToSRGB(preview, GAMMA));
+    });
+
+    session.m_frameCallback = [&](const AccumulationBuffer& accumulation, u32 sampleCount) {
+        previewWorker.publish(accumulation, sampleCount);
+    };
+
+    // Commands are read on their own thread so frames keep rendering while waiting for input.
+    // The thread stays blocked in getline after a quit, so it shares the queue instead of referencing locals.
+    struct CommandQueue {
+        std::mutex mutex;
+        std::deque<std::string> commands;
+    };
+    auto commandQueue = makeRef<CommandQueue>();
+    std::thread([commandQueue]() {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            std::scoped_lock lock(commandQueue->mutex);
+            commandQueue->commands.push_back(line);
+        }
+
+        std::scoped_lock lock(commandQueue->mutex);
+        commandQueue->commands.push_back("quit");
+    }).detach();
+
+    if (!std::filesystem::exists(OUTPUT_FOLDER))
+        std::filesystem::create_directory(OUTPUT_FOLDER);
+
+    const auto& hittables = world->hierarchy.hittables();
+    while (true) {
+        std::deque<std::string> pendingCommands;
+        {
+            std::scoped_lock lock(commandQueue->mutex);
+            std::swap(pendingCommands, commandQueue->commands);
+        }
+
+        for (const auto& command : pendingCommands) {
+            std::istringstream tokens(command);
+            std::string name;
+            tokens >> name;
+
+            if (name == "quit") {
+                previewWorker.flush();
+                return;
+            }
+
+            if (name == "orbit") {
+                f32 degrees = 0;
+                tokens >> degrees;
+                session.editCamera([&](Camera& camera) {
+                    camera.m_position = camera.m_lookAt + glm::angleAxis(glm::radians(degrees), camera.m_up) * (camera.m_position - camera.m_lookAt);
+                });
+            }
+            else if (name == "fov") {
+                f32 degrees = 0;
+                tokens >> degrees;
+                session.editCamera([&](Camera& camera) { camera.m_fov = degrees; });
+            }
+            else if (name == "move" || name == "albedo") {
+                u32 index = 0;
+                vec3 value;
+                tokens >> index >> value.x >> value.y >> value.z;
+                if (!tokens || index >= hittables.size()) {
+                    LOG(std::format("Invalid command: {}", command));
+                    continue;
+                }
+
+                if (name == "move") {
+                    if (auto transform = findTransform(hittables[index]))
+                        session.editTransform(*transform, [&](Transform& transform) { transform.setPosition(value); });
+                    else
+                        LOG(std::format("Hittable {} has no transform", index));
+                }
+                else {
+                    if (auto material = findMaterial(hittables[index]))
+                        session.editMaterial(*material, [&](Material& material) { material.albedo = value; });
+                    else
+                        LOG(std::format("Hittable {} has no material", index));
+                }
+            }
+            else if (!name.empty())
+                LOG(std::format("Unknown command: {}", command));
+        }
+
+        session.renderFrame();
+
+        const auto& stats = session.stats();
+        if (stats.frameCount % 30 == 0)
+            LOG(std::format("Frame {}: {:.2f}ms, {} samples", stats.frameCount, stats.frameTime.count() / 1000.0, session.sampleCount()));
+    }
+}
+
+constexpr const char* USAGE = "Usage: longweekend [--scene <index>] [--partition <index> <count>] [--resume <checkpoint>] [--samples <count>] [--time-budget <seconds>] [--target-error <rmse>] [--region <x> <y> <width> <height>] [--progressive <levels>] [--texture-budget <MB>] | --merge <partial files...> | --batch <jobs file> [concurrency] | --serve [port] [--allow-quit] | --interactive [scene] | --texture-benchmark [texture] | --texture-test, in all modes [--quantize-vertices] [--geometry-budget <MB>]";
+
+/*
+ * @brief Applies the scene loading options shared by all modes and removes them from args.
+ */
+void applyLoadOptions(std::vector<std::string>& args) {
+    for (size_t i = 0; i < args.size();) {
+        if (args[i] == "--quantize-vertices") {
+            VERTEX_FORMAT = VertexFormat::Quantized;
+            args.erase(args.begin() + i);
+        }
+        else if (args[i] == "--geometry-budget" && i + 1 < args.size()) {
+            // Geometry is loaded in core without a budget
+            GEOMETRY_PAGE_CACHE.m_memoryBudget = (size_t)(std::stod(args[i + 1]) * 1024 * 1024);
+            OUT_OF_CORE_GEOMETRY = &GEOMETRY_PAGE_CACHE;
+            args.erase(args.begin() + i, args.begin() + i + 2);
+        }
+        else
+            i++;
     }
-    if (renderer.m_outputChannels & (u32)Renderer::OutputChannel::Depth)
-        writeEXR(OUTPUT_FOLDER / "depth.exr", output.depth);
-    if (renderer.m_outputChannels & (u32)Renderer::OutputChannel::Normal)
-        writeEXR(OUTPUT_FOLDER / "normal.exr", output.normal);
-    if (renderer.m_outputChannels & (u32)Renderer::OutputChannel::Albedo)
-        writeEXR(OUTPUT_FOLDER / "albedo.exr", output.albedo);
-    if (renderer.m_outputChannels & (u32)Renderer::OutputChannel::Emission)
-        writeEXR(OUTPUT_FOLDER / "emission.exr", output.emission);
-#ifdef BVH_TEST
-    if (renderer.m_outputChannels & (u32)Renderer::OutputChannel::AABBTestCount)
-        writeEXR(OUTPUT_FOLDER / "aabb-test-count.exr", output.aabbTestCount);
-    if (renderer.m_outputChannels & (u32)Renderer::OutputChannel::TriangleTestCount)
-        writeEXR(OUTPUT_FOLDER / "triangle-test-count.exr", output.triangleTestCount);
-#endif
 }
 
+/*
+ * Usage:
+ *   longweekend [options]                          Render the whole frame
+ *   longweekend --merge <partial files...>         Merge partial files into the final output
+ *   longweekend --batch <jobs file> [concurrency]  Render all jobs of a batch file, see loadBatchJobs
+ *   longweekend --serve [port] [--allow-quit]      Run the render service on localhost, see RenderService
+ *   longweekend --interactive [scene]              Render progressively and apply edits from stdin, see renderInteractive
+ *   longweekend --texture-benchmark [texture]      Compare the texture layouts and batched sampling
+ *   longweekend --texture-test                     Check that passing textures around doesn't copy them, needs TEXTURE_TEST
+ *
+ * Options:
+ *   --scene <index>                                Scene to render
+ *   --partition <index> <count>                    Render every count-th sample starting at index (0 based) into a partial file
+ *   --resume <checkpoint>                          Continue an interrupted render from its checkpoint or partial file
+ *   --samples <count>                              Override the sample count of the frame, can extend a resumed render
+ *   --time-budget <seconds>                        Stop sampling when the next sample wouldn't finish in time
+ *   --region <x> <y> <width> <height>              Render only a region and merge it into the previous output
+ *   --progressive <levels>                         Render the first sample coarse to fine, starting at 1/2^levels resolution, up to 6 levels
+ *   --target-error <rmse>                          Stop sampling when the estimated error of the color drops below the target
+ *   --texture-budget <MB>                          Track the texture reads and keep the texture cache under the budget
+ *
+ * Scene loading options, in all modes:
+ *   --quantize-vertices                            Store the vertex attributes of the meshes quantized
+ *   --geometry-budget <MB>                         Keep the meshes out of core, paged in from the geometry cache under the budget
+ */
 i32 main(i32 argc, char** argv) {
-    render();
+    std::vector<std::string> args(argv + 1, argv + argc);
+    applyLoadOptions(args);
+
+    if (!args.empty() && args[0] == "--merge") {
+        merge(std::vector<std::filesystem::path>(args.begin() + 1, args.end()));
+        return EXIT_SUCCESS;
+    }
+
+    if (!args.empty() && args[0] == "--interactive") {
+        renderInteractive(args.size() >= 2 ? std::stoul(args[1]) : 2);
+        return EXIT_SUCCESS;
+    }
+
+    if (!args.empty() && args[0] == "--texture-benchmark") {
+        benchmarkTextureSampling(args.size() >= 2 ? args[1] : "");
+        return EXIT_SUCCESS;
+    }
+
+    if (!args.empty() && args[0] == "--texture-test")
+        return testTextureSharing(sphereScene, createRenderer, savePreview, saveOutput) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (!args.empty() && args[0] == "--serve") {
+        RenderService service(loadScene, createRenderer, [](const RenderJob& job, const Renderer::Output& output, u32 channels) {
+            saveOutput(output, channels, OUTPUT_FOLDER / job.name);
+        });
+        for (size_t i = 1; i < args.size(); i++) {
+            if (args[i] == "--allow-quit")
+                service.m_allowQuit = true;
+            else
+                service.m_port = (u16)std::stoul(args[i]);
+        }
+
+        service.run();
+        return EXIT_SUCCESS;
+    }
+
+    if (!args.empty() && args[0] == "--batch" && args.size() >= 2) {
+        renderBatch(args[1], args.size() >= 3 ? std::stoul(args[2]) : 1);
+        return EXIT_SUCCESS;
+    }
+
+    RenderOptions options;
+    bool isValid = true;
+    try {
+        for (size_t i = 0; i < args.size(); i++) {
+            if (args[i] == "--scene" && i + 1 < args.size())
+                options.sceneIndex = std::stoul(args[++i]);
+            else if (args[i] == "--partition" && i + 2 < args.size()) {
+                options.partitionIndex = std::stoul(args[++i]);
+                options.partitionCount = std::stoul(args[++i]);
+                isValid &= options.partitionCount > 0 && options.partitionIndex < options.partitionCount;
+            }
+            else if (args[i] == "--resume" && i + 1 < args.size())
+                options.resumeFrom = args[++i];
+            else if (args[i] == "--samples" && i + 1 < args.size())
+                options.samples = std::stoul(args[++i]);
+            else if (args[i] == "--time-budget" && i + 1 < args.size())
+                options.timeBudget = std::chrono::milliseconds((i64)(std::stod(args[++i]) * 1000));
+            else if (args[i] == "--target-error" && i + 1 < args.size())
+                options.targetError = std::stof(args[++i]);
+            else if (args[i] == "--region" && i + 4 < args.size()) {
+                options.regionOffset.x = std::stoul(args[++i]);
+                options.regionOffset.y = std::stoul(args[++i]);
+                options.regionSize.x = std::stoul(args[++i]);
+                options.regionSize.y = std::stoul(args[++i]);
+            }
+            else if (args[i] == "--progressive" && i + 1 < args.size()) {
+                options.progressiveLevels = std::stoul(args[++i]);
+                isValid &= options.progressiveLevels <= Renderer::MAX_PROGRESSIVE_LEVELS;
+            }
+            else if (args[i] == "--texture-budget" && i + 1 < args.size())
+                options.textureBudget = (size_t)(std::stod(args[++i]) * 1024 * 1024);
+            else {
+                isValid = false;
+                break;
+            }
+        }
+    }
+    catch (const std::exception&) {
+        isValid = false;  // Malformed numbers
+    }
+
+    if (!isValid) {
+        LOG(USAGE);
+        return EXIT_FAILURE;
+    }
+
+    render(options);
     return EXIT_SUCCESS;
 }